@@ -17,19 +17,248 @@
 * along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
 #include "Casc/Common.hpp"
 #include "Casc/Exceptions.hpp"
 
 const char* usageText =
-"Usage: casc <location> <mode> <key> [<output_name>]\n\n"
+"Usage: casc <location> <mode> <key> [<output_name>]\n"
+"       casc <location> extract <listfile> <output_dir> [<threads>] [<pattern>]\n\n"
 "<location>     - path to the game directory\n"
-"<mode>         - valid values: key, hash, filename\n"
+"<mode>         - valid values: key, hash, filename, extract\n"
 "<key>          - the key, hash or filename (depending on the mode) for the file\n"
-"<output_name>  - output name of the file";
+"<output_name>  - output name of the file\n"
+"<listfile>     - text file with one filename per line\n"
+"<output_dir>   - directory the files are extracted to\n"
+"<threads>      - number of worker threads, 0 uses one per hardware thread\n"
+"<pattern>      - only extract filenames matching this pattern (* and ?)";
+
+// The amount of decoded data written to disk at a time.
+const size_t WriteChunkSize = 1024 * 1024;
+
+/**
+ * Matches a filename against a pattern with * and ?, ignoring case
+ * and treating / and \ as the same character.
+ */
+bool matches(const char *pattern, const char *name)
+{
+    auto normalize = [](char c)
+    {
+        return c == '/' ? '\\' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    };
+
+    const char *star = nullptr;
+    const char *resume = nullptr;
+
+    while (*name)
+    {
+        if (*pattern == '*')
+        {
+            star = pattern++;
+            resume = name;
+        }
+        else if (*pattern == '?' || (*pattern && normalize(*pattern) == normalize(*name)))
+        {
+            ++pattern;
+            ++name;
+        }
+        else if (star)
+        {
+            pattern = star + 1;
+            name = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (*pattern == '*')
+    {
+        ++pattern;
+    }
+
+    return *pattern == '\0';
+}
+
+/**
+ * Checks that a listfile name stays inside the output directory once it is
+ * appended to it, so it can't be absolute or step up with "..".
+ */
+bool isRelativePath(const std::string &name)
+{
+    auto relative = name;
+    std::replace(relative.begin(), relative.end(), '\\', '/');
+
+    Casc::fs::path path(relative);
+
+    if (path.has_root_path())
+    {
+        return false;
+    }
+
+    for (auto &part : path)
+    {
+        if (part == "..")
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Writes a file to disk a chunk at a time and returns the number of bytes written.
+ */
+size_t writeFile(Casc::IO::Stream &file, const std::string &path)
+{
+    std::ofstream fs(path, std::ios_base::out | std::ios_base::binary);
+
+    if (fs.fail())
+    {
+        throw Casc::Exceptions::IOException("Failed to open output file for writing.");
+    }
+
+    std::vector<char> chunk(std::min(file.size(), WriteChunkSize));
+    size_t written = 0;
+
+    while (written < file.size())
+    {
+        auto count = file.readRange(written, chunk.data(), chunk.size());
+
+        if (count == 0)
+        {
+            throw Casc::Exceptions::IOException("Failed to read the file data.");
+        }
+
+        fs.write(chunk.data(), count);
+
+        if (fs.fail())
+        {
+            throw Casc::Exceptions::IOException("Failed to write the file data.");
+        }
+
+        written += count;
+    }
+
+    return written;
+}
+
+/**
+ * Extracts the files in a listfile on several threads.
+ */
+int extract(const char *location, const char *listfile, const char *outputDir, size_t threads, const char *pattern)
+{
+    std::vector<std::string> names;
+    size_t rejected = 0;
+
+    {
+        std::ifstream list(listfile);
+
+        if (list.fail())
+        {
+            std::cout << "Failed to open the listfile." << std::endl;
+            return -1;
+        }
+
+        std::string line;
+
+        while (std::getline(list, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            if (line.empty() || (pattern != nullptr && !matches(pattern, line.c_str())))
+            {
+                continue;
+            }
+
+            if (!isRelativePath(line))
+            {
+                std::cout << "Skipping " << line << ", it would be written outside the output directory." << std::endl;
+                ++rejected;
+                continue;
+            }
+
+            names.push_back(line);
+        }
+    }
+
+    Casc::ContainerOptions options;
+    options.threads = threads;
+
+    auto container = std::make_unique<Casc::Container>(location, "Data", options);
+
+    std::atomic<size_t> files{ 0 };
+    std::atomic<size_t> bytes{ 0 };
+    std::vector<std::pair<size_t, std::string>> failed;
+    std::mutex mutex;
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto missing = container->openFilesByName(names, [&](size_t i, std::shared_ptr<Casc::IO::Stream> file)
+    {
+        auto relative = names[i];
+        std::replace(relative.begin(), relative.end(), '\\', '/');
+
+        auto path = Casc::fs::path(outputDir) / relative;
+
+        try
+        {
+            std::error_code ec;
+            Casc::fs::create_directories(path.parent_path(), ec);
+
+            bytes += writeFile(*file, path.string());
+            ++files;
+        }
+        catch (std::exception &ex)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed.emplace_back(i, ex.what());
+        }
+    }, true);
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto i : missing)
+    {
+        failed.emplace_back(i, "not found in the container");
+    }
+
+    std::sort(failed.begin(), failed.end());
+
+    for (auto &failure : failed)
+    {
+        std::cout << "Couldn't extract " << names[failure.first] << " (" << failure.second << ")." << std::endl;
+    }
+
+    auto megabytes = bytes / (1024.0 * 1024.0);
+
+    std::cout << std::fixed << std::setprecision(1)
+        << "Extracted " << files << " files (" << megabytes << " MB) in " << seconds << " s, "
+        << (seconds > 0 ? files / seconds : 0.0) << " files/s, "
+        << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s." << std::endl;
+
+    return failed.empty() && rejected == 0 ? 0 : -1;
+}
 
 int main(int argc, char* argv[])
 {
@@ -39,13 +268,60 @@ int main(int argc, char* argv[])
         return 0;
     }
 
+    if (strcmp(argv[2], "extract") == 0)
+    {
+        if (argc < 5)
+        {
+            std::cout << usageText << std::endl;
+            return 0;
+        }
+
+        size_t threads = 0;
+
+        try
+        {
+            if (argc > 5)
+            {
+                size_t end = 0;
+                threads = std::stoul(argv[5], &end);
+
+                // stoul accepts a sign and stops at the first non-digit.
+                if (!std::isdigit(static_cast<unsigned char>(argv[5][0])) || argv[5][end] != '\0')
+                {
+                    throw std::invalid_argument("threads");
+                }
+            }
+        }
+        catch (std::logic_error &)
+        {
+            // Thrown as invalid_argument or out_of_range.
+            std::cout << usageText << std::endl;
+            return -1;
+        }
+
+        try
+        {
+            return extract(argv[1], argv[3], argv[4], threads,
+                argc > 6 ? argv[6] : nullptr);
+        }
+        catch (Casc::Exceptions::CascException &ex)
+        {
+            std::stringstream ss;
+
+            ss << "Failed to open the CASC container (" << ex.what() << ").";
+
+            std::cout << ss.str() << std::endl;
+            return -1;
+        }
+    }
+
     try
     {
         auto container = std::make_unique<Casc::Container>(argv[1], "Data");
 
         try
         {
-            std::shared_ptr<std::istream> file;
+            std::shared_ptr<Casc::IO::Stream> file;
             
             if (strcmp(argv[2], "key") == 0)
             {
@@ -57,63 +333,27 @@ int main(int argc, char* argv[])
             }
             else if (strcmp(argv[2], "filename") == 0)
             {
-                return -1;
+                file = container->openFileByName(argv[3]);
             }
             else
             {
                 std::cout << usageText << std::endl;
                 return 0;
             }
-            
-            std::fstream fs;
 
-            try
-            {
-                if (argc > 4)
-                {
-                    fs.open(argv[4], std::ios_base::out | std::ios_base::binary);
-                }
-                else
-                {
-                    fs.open(argv[3], std::ios_base::out | std::ios_base::binary);
-                }
-            }
-            catch (...)
-            {
-                std::cout << "Failed to open output file for writing." << std::endl;
-                return -1;
-            }
-
-            file->seekg(0, std::ios_base::end);
-            auto size = file->tellg();
-
-            if (size <= 0)
+            if (file->size() == 0)
             {
                 std::cout << "Invalid file size." << std::endl;
                 return -1;
             }
 
-            file->seekg(0, std::ios_base::beg);
-            
             try
             {
-                std::unique_ptr<char[]> arr = std::make_unique<char[]>((size_t)size);
-                file->read(arr.get(), (size_t)size);
-
-                try
-                {
-                    fs.write(arr.get(), size);
-                    fs.close();
-                }
-                catch (...)
-                {
-                    std::cout << "Failed to write the file data." << std::endl;
-                    return -1;
-                }
+                writeFile(*file, argc > 4 ? argv[4] : argv[3]);
             }
-            catch (...)
+            catch (Casc::Exceptions::IOException &ex)
             {
-                std::cout << "Failed to read the file data." << std::endl;
+                std::cout << ex.what() << std::endl;
                 return -1;
             }
         }
@@ -156,4 +396,4 @@ int main(int argc, char* argv[])
     }
     
     return 0;
-}
+}
\ No newline at end of file
@@ -3,8 +3,14 @@
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
+#include <algorithm>
+#include <exception>
 #include <fstream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <thread>
 #include <vector>
 #include <experimental/filesystem>
@@ -22,6 +28,214 @@ namespace CascLibTest
     std::vector<char> noneData;
     std::vector<char> zData;
 
+    /**
+     * Puts the data header a data file has in front of each file: the
+     * reversed key of the file, the size including the header, and padding.
+     */
+    std::vector<char> withDataHeader(const std::vector<char> &data, size_t headerSize)
+    {
+        MD5 md5;
+        md5.update(data.data(), static_cast<MD5::size_type>(headerSize));
+        md5.finalize();
+
+        auto digest = md5.rawdigest();
+        auto size = IO::Endian::write<IO::EndianType::Little, uint32_t>(static_cast<uint32_t>(data.size() + 30));
+
+        std::vector<char> file(digest.rbegin(), digest.rend());
+        file.insert(file.end(), size.begin(), size.end());
+        file.resize(30, '\0');
+        file.insert(file.end(), data.begin(), data.end());
+
+        return file;
+    }
+
+    /**
+     * A record of an .idx file: the key, the data file, the offset in it and the size.
+     */
+    struct IndexRecord
+    {
+        std::string key;
+        uint16_t file;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    /**
+     * Builds an .idx file for a bucket, with 9 byte keys, 5 byte locations
+     * with a 30 bit offset, and 4 byte sizes.
+     */
+    std::vector<char> indexFile(uint16_t bucket, const std::vector<IndexRecord> &records)
+    {
+        std::vector<char> header{ 7, 0, char(bucket), char(bucket >> 8), 4, 5, 9, 30, 0, 0, 0, 0, 0, 0, 0, 0 };
+        std::vector<char> data;
+
+        for (auto &record : records)
+        {
+            IndexKey key(record.key);
+            data.insert(data.end(), key.begin(), key.end());
+
+            auto location = (uint64_t(record.file) << 30) | record.offset;
+
+            for (auto i = 4; i >= 0; --i)
+            {
+                data.push_back(static_cast<char>(location >> (i * 8)));
+            }
+
+            auto size = IO::Endian::write<IO::EndianType::Little, uint32_t>(record.size);
+            data.insert(data.end(), size.begin(), size.end());
+        }
+
+        // The records are hashed one at a time, chaining the hash.
+        std::pair<uint32_t, uint32_t> dataHash{ 0, 0 };
+
+        for (auto it = data.begin(); it != data.end(); it += 18)
+        {
+            dataHash = Crypto::lookup3(it, it + 18, dataHash);
+        }
+
+        auto put = [](std::vector<char> &file, uint32_t value)
+        {
+            auto bytes = IO::Endian::write<IO::EndianType::Little, uint32_t>(value);
+            file.insert(file.end(), bytes.begin(), bytes.end());
+        };
+
+        std::vector<char> file;
+        put(file, static_cast<uint32_t>(header.size()));
+        put(file, Crypto::lookup3(header.begin(), header.end(), 0));
+        file.insert(file.end(), header.begin(), header.end());
+
+        // The records start at the next 16 byte boundary.
+        file.resize(32, '\0');
+        put(file, static_cast<uint32_t>(data.size()));
+        put(file, dataHash.first);
+        file.insert(file.end(), data.begin(), data.end());
+
+        return file;
+    }
+
+    /**
+     * Builds an encoding file with one page in each table. Table A maps
+     * 0101... to 1111... and 0202... to 2222... and 3333..., and table B
+     * lists the three keys with the profiles n, z and none.
+     */
+    std::vector<char> encodingFile()
+    {
+        auto put = [](std::vector<char>::iterator it, const std::string &hex)
+        {
+            FileKey key(hex);
+            std::copy(key.begin(), key.end(), it);
+        };
+
+        auto md5 = [](const std::vector<char> &page)
+        {
+            MD5 md5;
+            md5.update(page.data(), static_cast<MD5::size_type>(page.size()));
+            md5.finalize();
+
+            auto digest = md5.rawdigest();
+
+            return std::vector<char>(digest.begin(), digest.end());
+        };
+
+        // Key count, big endian file size, content hash and keys.
+        std::vector<char> pageA(4096, '\0');
+        std::vector<char> first{ 1, 0, 0, 0, 0, 100 };
+        std::vector<char> second{ 2, 0, 0, 0, 1, 0 };
+        std::copy(first.begin(), first.end(), pageA.begin());
+        put(pageA.begin() + 6, "01010101010101010101010101010101");
+        put(pageA.begin() + 22, "11111111111111111111111111111111");
+        std::copy(second.begin(), second.end(), pageA.begin() + 38);
+        put(pageA.begin() + 44, "02020202020202020202020202020202");
+        put(pageA.begin() + 60, "22222222222222222222222222222222");
+        put(pageA.begin() + 76, "33333333333333333333333333333333");
+
+        // Key, big endian profile index, a zero byte and the big endian encoded size.
+        std::vector<char> pageB(4096, '\0');
+        std::vector<char> profiles{ 0, 0, 0, 0, 0, 0, 0, 0, 80, 0, 0, 0, 1, 0, 0, 0, 0, '\xC8', -1, -1, -1, -1, 0, 0, 0, 1, 0x2C };
+
+        for (auto i = 0; i < 3; ++i)
+        {
+            put(pageB.begin() + 25 * i, std::string(32, char('1' + i)));
+            std::copy(profiles.begin() + 9 * i, profiles.begin() + 9 * (i + 1), pageB.begin() + 25 * i + 16);
+        }
+
+        std::vector<char> file{ 'E', 'N', 1, 16, 16, 0, 4, 0, 4, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 4, 'n', '\0', 'z', '\0' };
+
+        std::vector<char> headerA(16);
+        put(headerA.begin(), "01010101010101010101010101010101");
+        file.insert(file.end(), headerA.begin(), headerA.end());
+
+        auto digestA = md5(pageA);
+        file.insert(file.end(), digestA.begin(), digestA.end());
+        file.insert(file.end(), pageA.begin(), pageA.end());
+
+        std::vector<char> headerB(16);
+        put(headerB.begin(), "11111111111111111111111111111111");
+        file.insert(file.end(), headerB.begin(), headerB.end());
+
+        auto digestB = md5(pageB);
+        file.insert(file.end(), digestB.begin(), digestB.end());
+        file.insert(file.end(), pageB.begin(), pageB.end());
+
+        // The profile of the encoding file itself.
+        file.push_back('n');
+        file.push_back('\0');
+
+        // Stored in a data file as a single None chunk without a block table.
+        std::vector<char> blte{ 'B', 'L', 'T', 'E', 0, 0, 0, 0, 'N' };
+        blte.insert(blte.end(), file.begin(), file.end());
+
+        return withDataHeader(blte, blte.size());
+    }
+
+    /**
+     * A source over a buffer that can't be viewed in place, like a data file read
+     * by offset. It counts the reads made through it and its slices, and remembers
+     * how far into the buffer they reached.
+     */
+    class CountingSource : public IO::DataSource
+    {
+        std::shared_ptr<const std::vector<char>> data;
+
+    public:
+        // The number of reads, shared with the slices.
+        std::shared_ptr<size_t> reads;
+
+        // One past the last byte read, shared with the slices.
+        std::shared_ptr<size_t> furthest;
+
+        CountingSource(std::shared_ptr<const std::vector<char>> data, std::shared_ptr<size_t> reads,
+            std::shared_ptr<size_t> furthest, std::pair<size_t, size_t> bounds)
+            : DataSource(IO::DataSourceType::File, bounds), data(data), reads(reads), furthest(furthest)
+        { }
+
+        CountingSource(const std::vector<char> &data)
+            : CountingSource(std::make_shared<std::vector<char>>(data), std::make_shared<size_t>(0),
+                std::make_shared<size_t>(0), { 0, data.size() })
+        { }
+
+        size_t read(size_t offset, char *dest, size_t count) override
+        {
+            auto first = lower_bound + offset;
+            count = first < upper_bound ? std::min(count, upper_bound - first) : 0;
+
+            std::memcpy(dest, data->data() + first, count);
+
+            ++*reads;
+            *furthest = std::max(*furthest, first + count);
+
+            return count;
+        }
+
+        using DataSource::read;
+
+        std::shared_ptr<DataSource> slice(size_t offset, size_t count) const override
+        {
+            return std::make_shared<CountingSource>(data, reads, furthest,
+                std::make_pair(lower_bound + offset, lower_bound + offset + count));
+        }
+    };
+
 	TEST_CLASS(CascLibTests)
 	{
 	public:
@@ -47,6 +261,69 @@ namespace CascLibTest
             fs.open("zlib.bin", std::ios_base::out | std::ios_base::binary);
             fs.write(reinterpret_cast<char*>(zData.data()), zData.size());
             fs.close();
+
+            // The same file as it is stored in a data file, with the block table as its key.
+            auto noneFile = withDataHeader(noneData, 60);
+
+            fs.open("nonefile.bin", std::ios_base::out | std::ios_base::binary);
+            fs.write(noneFile.data(), noneFile.size());
+            fs.close();
+
+            // Two buckets, the first with its records out of order and a key listed twice.
+            auto bucket0 = indexFile(0, {
+                { "bbbbbbbbbbbbbbbbbb", 2, 0x200, 50 },
+                { "aaaaaaaaaaaaaaaaaa", 1, 0x100, 40 },
+                { "cccccccccccccccccc", 3, 0x3FFFFFFF, 60 },
+                { "aaaaaaaaaaaaaaaaaa", 9, 0x900, 90 } });
+            auto bucket1 = indexFile(1, {
+                { "dddddddddddddddddd", 4, 0x400, 70 },
+                { "000000000000000001", 0, 0, 30 } });
+
+            std::experimental::filesystem::create_directories("index/data");
+            std::experimental::filesystem::create_directories("truncated/data");
+
+            fs.open("index/data/0000000001.idx", std::ios_base::out | std::ios_base::binary);
+            fs.write(bucket0.data(), bucket0.size());
+            fs.close();
+
+            fs.open("index/data/0100000001.idx", std::ios_base::out | std::ios_base::binary);
+            fs.write(bucket1.data(), bucket1.size());
+            fs.close();
+
+            // Cut off in the middle of the last record.
+            fs.open("truncated/data/0000000001.idx", std::ios_base::out | std::ios_base::binary);
+            fs.write(bucket0.data(), bucket0.size() - 5);
+            fs.close();
+
+            auto encoding = encodingFile();
+
+            std::experimental::filesystem::create_directories("encoding/data");
+
+            fs.open("encoding/data/data.000", std::ios_base::out | std::ios_base::binary);
+            fs.write(encoding.data(), encoding.size());
+            fs.close();
+
+            // Two data files with two files each, stored without a block table.
+            std::experimental::filesystem::create_directories("ordered/data");
+
+            for (auto number : { 0, 1 })
+            {
+                std::vector<char> data;
+
+                for (auto name : { "first", "second" })
+                {
+                    auto text = std::to_string(number) + " " + name;
+                    std::vector<char> blte{ 'B', 'L', 'T', 'E', 0, 0, 0, 0, 'N' };
+                    blte.insert(blte.end(), text.begin(), text.end());
+
+                    auto file = withDataHeader(blte, blte.size());
+                    data.insert(data.end(), file.begin(), file.end());
+                }
+
+                fs.open("ordered/data/data.00" + std::to_string(number), std::ios_base::out | std::ios_base::binary);
+                fs.write(data.data(), data.size());
+                fs.close();
+            }
         }
 
         TEST_CLASS_CLEANUP(Cleanup)
@@ -56,6 +333,13 @@ namespace CascLibTest
 
             zData.clear();
             std::experimental::filesystem::remove("zlib.bin");
+
+            std::experimental::filesystem::remove("nonefile.bin");
+
+            std::experimental::filesystem::remove_all("index");
+            std::experimental::filesystem::remove_all("truncated");
+            std::experimental::filesystem::remove_all("encoding");
+            std::experimental::filesystem::remove_all("ordered");
         }
 
         TEST_METHOD(NoneHandler)
@@ -85,7 +369,7 @@ namespace CascLibTest
                 0,
                 4,
                 0,
-                zData.size()
+                zData.size() - 36
             };
 
             auto source = std::make_shared<IO::Impl::MemoryMappedSource>(
@@ -99,6 +383,41 @@ namespace CascLibTest
             Assert::AreEqual(0, equal);
         }
 
+        TEST_METHOD(ZlibHandlerSeek)
+        {
+            std::vector<char> text(300000);
+
+            for (auto i = 0U; i < text.size(); ++i)
+            {
+                text[i] = static_cast<char>('a' + (i * 7 + i / 1000) % 26);
+            }
+
+            IO::Chunk chunk
+            {
+                0,
+                text.size(),
+                0,
+                0
+            };
+
+            auto encoded = IO::Impl::ZlibHandler(chunk, nullptr).encode(text);
+            chunk.size = encoded.size();
+
+            auto handler = std::make_shared<IO::Impl::ZlibHandler>(chunk, std::make_shared<IO::Impl::MemoryMappedSource>(encoded));
+
+            // Skips ahead, continues from there, then goes back and starts over.
+            for (auto offset : { 200000U, 201000U, 5000U, 0U, 299000U })
+            {
+                auto decoded = handler->decode(offset, 1000);
+
+                Assert::AreEqual(1000U, decoded.size());
+                Assert::AreEqual(0, std::memcmp(decoded.data(), text.data() + offset, decoded.size()));
+            }
+
+            auto decoded = handler->decode(0, text.size());
+            Assert::IsTrue(decoded == text);
+        }
+
         TEST_METHOD(NoneHandlerWithStream)
         {
             IO::Chunk chunk
@@ -126,11 +445,11 @@ namespace CascLibTest
                 0,
                 4,
                 0,
-                zData.size()
+                zData.size() - 36
             };
 
             auto stream = std::make_shared<std::ifstream>("zlib.bin", std::ios_base::in | std::ios_base::binary);
-            auto source = std::make_shared<IO::Impl::StreamSource>(stream, std::make_pair(36U, zData.size() - 36U));
+            auto source = std::make_shared<IO::Impl::StreamSource>(stream, std::make_pair(size_t(36), zData.size()));
 
             auto handler = std::make_shared<IO::Impl::ZlibHandler>(chunk, source);
 
@@ -141,6 +460,158 @@ namespace CascLibTest
             Assert::AreEqual(0, equal);
         }
 
+        TEST_METHOD(NoneHandlerWithFile)
+        {
+            auto file = std::make_shared<IO::PositionalFile>("nonefile.bin");
+            auto source = std::make_shared<IO::Impl::FileSource>(file);
+
+            char header[30];
+            char table[8];
+
+            auto count = source->read(0, { { header, sizeof(header) }, { table, sizeof(table) } });
+            Assert::AreEqual(38U, count);
+            Assert::AreEqual(0, std::memcmp(table, noneData.data(), sizeof(table)));
+
+            IO::Buffer b;
+            b.open(source, 0, nullptr, nullptr, IndexKey(), IO::Verification::Full);
+
+            char arr[8];
+            Assert::AreEqual(8, static_cast<int>(b.sgetn(arr, 8)));
+
+            auto equal = std::memcmp(arr, noneData.data() + 60 + 1, 4);
+            Assert::AreEqual(0, equal);
+            equal = std::memcmp(arr + 4, noneData.data() + 60 + 6, 4);
+            Assert::AreEqual(0, equal);
+        }
+
+        TEST_METHOD(VerifyChunkOnDecode)
+        {
+            std::vector<char> data{ 'N', 't', 'e', 's', 't' };
+
+            MD5 md5;
+            md5.update(data.data(), static_cast<MD5::size_type>(data.size()));
+            md5.finalize();
+
+            auto digest = md5.rawdigest();
+            IO::Chunk chunk{ 0, 4, 0, data.size(), FileKey(digest.begin(), digest.end()) };
+
+            auto good = std::make_shared<IO::Impl::NoneHandler>(chunk, std::make_shared<IO::Impl::MemoryMappedSource>(data));
+            good->verifyOnDecode(IndexKey());
+
+            auto decoded = good->decode(0, 4);
+            Assert::AreEqual(0, std::memcmp(decoded.data(), "test", 4));
+
+            // A corrupt chunk is only noticed when it is decoded.
+            data[4] = 'x';
+
+            auto bad = std::make_shared<IO::Impl::NoneHandler>(chunk, std::make_shared<IO::Impl::MemoryMappedSource>(data));
+            bad->verifyOnDecode(IndexKey());
+
+            Assert::ExpectException<Exceptions::InvalidHashException>([&bad]()
+            {
+                bad->decode(0, 4);
+            });
+
+            // A chunk found in the block cache isn't decoded, so it isn't hashed either.
+            auto cache = std::make_shared<IO::BlockCache>(1024);
+            cache->insert(IndexKey(), 0, std::make_shared<std::vector<char>>(decoded));
+
+            auto corrupt = std::make_shared<IO::Impl::NoneHandler>(chunk, std::make_shared<IO::Impl::MemoryMappedSource>(data));
+            corrupt->verifyOnDecode(IndexKey());
+
+            IO::Impl::CachedHandler cached(corrupt, nullptr, cache, IndexKey(), 0);
+            decoded = cached.decode(0, 4);
+            Assert::AreEqual(0, std::memcmp(decoded.data(), "test", 4));
+        }
+
+        TEST_METHOD(CryptHandlerWithSalsa20)
+        {
+            Crypto::KeyStore keys;
+            keys.add(0x1122334455667788, Key<16>(std::string("0123456789abcdef0123456789abcdef")));
+
+            // The mode byte and data of a None chunk, encrypted with a zero IV.
+            std::vector<char> inner{ 'N', 't', 'e', 's', 't' };
+            uint8_t nonce[8] = {};
+            Crypto::Salsa20(*keys.find(0x1122334455667788), nonce).apply(0, inner.data(), inner.size());
+
+            std::vector<char> data{ 'E', 8, '\x88', '\x77', '\x66', '\x55', '\x44', '\x33', '\x22', '\x11', 4, 0, 0, 0, 0, 'S' };
+            data.insert(data.end(), inner.begin(), inner.end());
+
+            IO::Chunk chunk
+            {
+                0,
+                4,
+                0,
+                data.size()
+            };
+
+            auto source = std::make_shared<IO::Impl::MemoryMappedSource>(data);
+            auto handler = std::make_shared<IO::Impl::CryptHandler>(chunk, source, &keys, 0);
+
+            auto decoded = handler->decode(0, 4);
+
+            Assert::AreEqual(std::string("test"), std::string(decoded.begin(), decoded.end()));
+        }
+
+        TEST_METHOD(Salsa20KnownAnswer)
+        {
+            // Set 1, vector 0 of the ECRYPT Salsa20 test vectors for 128 bit keys.
+            Crypto::KeyStore keys;
+            keys.add(1, Key<16>(std::string("80000000000000000000000000000000")));
+
+            uint8_t nonce[8] = {};
+            Crypto::Salsa20 cipher(*keys.find(1), nonce);
+
+            std::vector<char> stream(256);
+            cipher.apply(0, stream.data(), stream.size());
+
+            Assert::IsTrue(Key<64>(stream.begin(), stream.begin() + 64) == Key<64>(std::string(
+                "4DFA5E481DA23EA09A31022050859936DA52FCEE218005164F267CB65F5CFD7F"
+                "2B4F97E0FF16924A52DF269515110A07F9E460BC65EF95DA58F740B7D1DBB0AA")));
+            Assert::IsTrue(Key<64>(stream.begin() + 192, stream.end()) == Key<64>(std::string(
+                "DA9C1581F429E0A00F7D67E23B730676783B262E8EB43A25F55FB90B3E753AEF"
+                "8C6713EC66C51881111593CCB3E8CB8F8DE124080501EEEB389C4BCB6977CF95")));
+
+            // The key stream can be applied piecewise and out of order.
+            std::vector<char> pieces(256);
+            cipher.apply(200, pieces.data() + 200, 56);
+            cipher.apply(0, pieces.data(), 200);
+
+            Assert::IsTrue(pieces == stream);
+        }
+
+        TEST_METHOD(CryptHandlerWithChunkIndex)
+        {
+            Crypto::KeyStore keys;
+            keys.add(0x1122334455667788, Key<16>(std::string("80000000000000000000000000000000")));
+
+            // The None chunk "test", encrypted as the second chunk of a file with a zero IV.
+            // The chunk index is mixed into the IV, so this is the key stream for IV 01 00 00 00.
+            std::vector<char> data{ 'E', 8, '\x88', '\x77', '\x66', '\x55', '\x44', '\x33', '\x22', '\x11', 4, 0, 0, 0, 0, 'S',
+                '\x14', '\xCD', '\xA8', '\x44', '\x61' };
+
+            IO::Chunk chunk
+            {
+                0,
+                4,
+                0,
+                data.size()
+            };
+
+            auto source = std::make_shared<IO::Impl::MemoryMappedSource>(data);
+            auto handler = std::make_shared<IO::Impl::CryptHandler>(chunk, source, &keys, 1);
+
+            auto decoded = handler->decode(0, 4);
+
+            Assert::AreEqual(std::string("test"), std::string(decoded.begin(), decoded.end()));
+
+            // As the first chunk the mode byte decrypts to garbage.
+            Assert::ExpectException<Exceptions::InvalidEncodingModeException>([&chunk, &source, &keys]()
+            {
+                IO::Impl::CryptHandler(chunk, source, &keys, 0);
+            });
+        }
+
         TEST_METHOD(ParseBlockTable)
         {
             auto blockTableSize = IO::Buffer::getBlockTableSize(noneData.begin());
@@ -148,10 +619,75 @@ namespace CascLibTest
             Assert::AreEqual(2U, chunks.size());
         }
 
+        TEST_METHOD(ValidateChunks)
+        {
+            auto blockTableSize = IO::Buffer::getBlockTableSize(noneData.begin());
+            auto chunks = IO::Buffer::parseBlockTable(noneData.begin() + 8, noneData.begin() + blockTableSize);
+
+            for (auto &chunk : chunks)
+            {
+                auto source = std::make_shared<IO::Impl::MemoryMappedSource>(
+                    std::vector<char>{ noneData.begin() + 60 + chunk.offset, noneData.begin() + 60 + chunk.offset + chunk.size });
+                auto handler = std::make_shared<IO::Impl::NoneHandler>(chunk, source);
+
+                Assert::IsTrue(handler->validate());
+            }
+        }
+
+        TEST_METHOD(HashManyBuffers)
+        {
+            std::vector<std::vector<char>> data;
+            std::vector<std::pair<const char*, size_t>> buffers;
+
+            for (auto size = 0U; size < 200; size += 7)
+            {
+                data.emplace_back(size, char(size));
+            }
+
+            for (auto &v : data)
+            {
+                buffers.emplace_back(v.data(), v.size());
+            }
+
+            for (auto level : { Crypto::SimdLevel::Scalar, Crypto::SimdLevel::Sse2,
+                Crypto::SimdLevel::Avx2, Crypto::SimdLevel::Avx512 })
+            {
+                auto digests = Crypto::md5Many(buffers, level);
+
+                for (auto i = 0U; i < data.size(); ++i)
+                {
+                    Assert::IsTrue(MD5(data[i]).rawdigest() == digests[i]);
+                }
+            }
+        }
+
+        TEST_METHOD(HashManyNames)
+        {
+            std::vector<std::string> names;
+            std::vector<std::pair<const char*, size_t>> buffers;
+
+            for (auto size = 0U; size < 100; ++size)
+            {
+                names.emplace_back(size, char('A' + size % 26));
+            }
+
+            for (auto &name : names)
+            {
+                buffers.emplace_back(name.data(), name.size());
+            }
+
+            auto hashes = Crypto::lookup3Many(buffers, { 5, 7 });
+
+            for (auto i = 0U; i < names.size(); ++i)
+            {
+                Assert::IsTrue(Crypto::lookup3(names[i].begin(), names[i].end(), { 5, 7 }) == hashes[i]);
+            }
+        }
+
         TEST_METHOD(BufferWithNoneHandlers)
         {
             IO::Buffer b;
-            b.open("none.bin", 0);
+            b.open("nonefile.bin", 0);
 
             char arr[8];
 
@@ -162,10 +698,58 @@ namespace CascLibTest
             Assert::AreEqual(0, equal);
         }
 
+        TEST_METHOD(CreateHandlersOnFirstRead)
+        {
+            // A file of 200 None chunks with a block table too large for the first header read.
+            const uint32_t count = 200;
+            auto tableSize = 8 + 4 + 24 * count;
+
+            std::vector<char> blte{ 'B', 'L', 'T', 'E' };
+            auto size = IO::Endian::write<IO::EndianType::Big, uint32_t>(tableSize);
+            blte.insert(blte.end(), size.begin(), size.end());
+            blte.insert(blte.end(), { 0x0F, 0, char(count >> 8), char(count) });
+
+            for (auto i = 0U; i < count; ++i)
+            {
+                // The physical size, the logical size and the checksum.
+                blte.insert(blte.end(), { 0, 0, 0, 5, 0, 0, 0, 4 });
+                blte.resize(blte.size() + 16, '\0');
+            }
+
+            for (auto i = 0U; i < count; ++i)
+            {
+                blte.insert(blte.end(), { 'N', 't', 'e', 's', 't' });
+            }
+
+            // The mode byte of the last chunk is invalid, which is only noticed when it is read.
+            blte[blte.size() - 5] = 'Q';
+
+            auto source = std::make_shared<CountingSource>(withDataHeader(blte, tableSize));
+
+            IO::Buffer b;
+            b.open(source, 0);
+
+            // Opening reads the headers and nothing else, however many chunks there are.
+            Assert::IsTrue(*source->reads <= 2);
+            Assert::AreEqual(size_t(4 * count), b.size());
+
+            char arr[4];
+            Assert::AreEqual(4, static_cast<int>(b.sgetn(arr, 4)));
+            Assert::AreEqual(0, std::memcmp(arr, "test", 4));
+
+            // Only the first chunk has been read.
+            Assert::IsTrue(*source->furthest <= 30 + tableSize + 5);
+
+            Assert::ExpectException<Exceptions::InvalidEncodingModeException>([&b, &arr, count]()
+            {
+                b.readRange(4 * (count - 1), arr, 4);
+            });
+        }
+
         TEST_METHOD(GetFileSize)
         {
             IO::Buffer b;
-            b.open("none.bin", 0);
+            b.open("nonefile.bin", 0);
             auto pos = b.pubseekoff(0, std::ios_base::end);
 
             Assert::AreEqual(8U, (size_t)pos);
@@ -174,7 +758,7 @@ namespace CascLibTest
         TEST_METHOD(StreamRead)
         {
             IO::Stream stream;
-            stream.open("none.bin", 0);
+            stream.open("nonefile.bin", 0);
 
             stream.seekg(0, std::ios_base::end);
             auto size = stream.tellg();
@@ -199,6 +783,91 @@ namespace CascLibTest
             Assert::AreEqual(0, equal);
         }
 
+        TEST_METHOD(ConcurrentReads)
+        {
+            auto stream = std::make_shared<std::ifstream>("nonefile.bin", std::ios_base::in | std::ios_base::binary);
+            auto source = std::make_shared<IO::Impl::StreamSource>(stream, std::make_pair(size_t(0), noneData.size() + 30));
+
+            std::vector<std::thread> threads;
+            std::vector<int> results(8, 0);
+            std::vector<std::exception_ptr> errors(results.size());
+
+            for (auto t = 0U; t < results.size(); ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    // An exception leaving a thread ends the test run, so it is
+                    // rethrown on the test thread instead.
+                    try
+                    {
+                        for (auto i = 0; i < 100 && results[t] == 0; ++i)
+                        {
+                            IO::Buffer b;
+                            b.open(source, 0);
+
+                            char arr[8];
+                            b.sgetn(arr, 8);
+
+                            results[t] = std::memcmp(arr, noneData.data() + 60 + 1, 4) |
+                                std::memcmp(arr + 4, noneData.data() + 60 + 6, 4);
+                        }
+                    }
+                    catch (...)
+                    {
+                        errors[t] = std::current_exception();
+                    }
+                });
+            }
+
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+
+            for (auto &error : errors)
+            {
+                if (error != nullptr)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            for (auto result : results)
+            {
+                Assert::AreEqual(0, result);
+            }
+        }
+
+        TEST_METHOD(KeyFromString)
+        {
+            FileKey key("0123456789abcdef0123456789ABCDEF");
+            IndexKey prefix(key);
+
+            Assert::AreEqual(std::string("0123456789abcdef0123456789abcdef"), key.string());
+            Assert::AreEqual(std::string("0123456789abcdef01"), prefix.string());
+            Assert::IsTrue(IndexKey(key.begin(), key.end()) == prefix);
+            Assert::IsTrue(prefix < IndexKey("0123456789abcdef02"));
+        }
+
+        TEST_METHOD(BlockCacheEviction)
+        {
+            IO::BlockCache cache(100);
+            IndexKey key("0123456789abcdef01");
+
+            cache.insert(key, 0, std::make_shared<std::vector<char>>(40));
+            cache.insert(key, 1, std::make_shared<std::vector<char>>(40));
+            Assert::IsTrue(cache.find(key, 0) != nullptr);
+
+            cache.insert(key, 2, std::make_shared<std::vector<char>>(40));
+            Assert::IsTrue(cache.find(key, 1) == nullptr);
+            Assert::IsTrue(cache.find(key, 0) != nullptr);
+
+            auto stats = cache.statistics();
+            Assert::AreEqual(80U, stats.bytes);
+            Assert::AreEqual(2U, stats.hits);
+            Assert::AreEqual(1U, stats.misses);
+        }
+
         TEST_METHOD(ReadBuildInfo)
         {
             Parsers::Text::BuildInfo buildInfo(R"(I:\Diablo III\.build.info)");
@@ -337,5 +1006,374 @@ namespace CascLibTest
             delete[] arr;
         }
 
+        TEST_METHOD(ReadFileAsync)
+        {
+            auto container = std::make_unique<Container>(
+                R"(I:\World of Warcraft)",
+                R"(Data)");
+
+            auto data = container->readAsync(std::string("SPELLS\\BONE_CYCLONE_STATE.M2"));
+            auto file = container->openFileAsync(std::string("SPELLS\\BONE_CYCLONE_STATE.M2")).get();
+
+            Assert::AreEqual(file->size(), data.get().size());
+        }
+
+        TEST_METHOD(LoadContainerFromSnapshot)
+        {
+            ContainerOptions options;
+            options.snapshot = true;
+
+            // The first container writes the snapshot, the second one maps it.
+            auto parsed = std::make_unique<Container>(
+                R"(I:\World of Warcraft)",
+                R"(Data)", options);
+
+            auto mapped = std::make_unique<Container>(
+                R"(I:\World of Warcraft)",
+                R"(Data)", options);
+
+            auto expected = parsed->openFileByName("SPELLS\\BONE_CYCLONE_STATE.M2")->readAll();
+            auto actual = mapped->openFileByName("SPELLS\\BONE_CYCLONE_STATE.M2")->readAll();
+
+            Assert::IsTrue(expected == actual);
+        }
+
+        TEST_METHOD(RejectCorruptSnapshot)
+        {
+            std::vector<uint32_t> values{ 1, 2, 3, 4 };
+
+            IO::SnapshotWriter writer("corrupt.snapshot");
+            writer.write(values.data(), values.size());
+            writer.close();
+
+            {
+                IO::SnapshotReader reader("corrupt.snapshot");
+                Assert::AreEqual(values.size(), reader.readArray<uint32_t>().size());
+            }
+
+            std::fstream fs("corrupt.snapshot", std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+            fs.seekp(-1, std::ios_base::end);
+            fs.put('\x7F');
+            fs.close();
+
+            Assert::ExpectException<Exceptions::ParserException>([]()
+            {
+                IO::SnapshotReader reader("corrupt.snapshot");
+            });
+
+            std::experimental::filesystem::remove("corrupt.snapshot");
+        }
+
+        TEST_METHOD(GetFileByMissingId)
+        {
+            auto container = std::make_unique<Container>(
+                R"(I:\World of Warcraft)",
+                R"(Data)");
+
+            Assert::ExpectException<Exceptions::FileIdDoesNotExistException>([&container]()
+            {
+                container->openFileById(0xFFFFFFFE);
+            });
+        }
+
+        TEST_METHOD(ParseIndex)
+        {
+            auto allocator = std::make_shared<IO::StreamAllocator>("index");
+            Parsers::Binary::Index index({ { 0, 1 }, { 1, 1 } }, allocator);
+
+            auto first = index.find(IndexKey(std::string("000000000000000001")));
+            Assert::AreEqual(0U, first.file());
+            Assert::AreEqual(0U, first.offset());
+            Assert::AreEqual(30U, first.size());
+
+            // The first record of a key listed twice is kept.
+            auto duplicate = index.find(IndexKey(std::string("aaaaaaaaaaaaaaaaaa")));
+            Assert::AreEqual(1U, duplicate.file());
+            Assert::AreEqual(0x100U, duplicate.offset());
+            Assert::AreEqual(40U, duplicate.size());
+
+            auto largest = index.find(IndexKey(std::string("cccccccccccccccccc")));
+            Assert::AreEqual(3U, largest.file());
+            Assert::AreEqual(0x3FFFFFFFU, largest.offset());
+
+            auto other = index.find(IndexKey(std::string("dddddddddddddddddd")));
+            Assert::AreEqual(4U, other.file());
+            Assert::AreEqual(70U, other.size());
+
+            Assert::ExpectException<Exceptions::KeyDoesNotExistException>([&index]()
+            {
+                index.find(IndexKey(std::string("eeeeeeeeeeeeeeeeee")));
+            });
+        }
+
+        TEST_METHOD(ParseTruncatedIndex)
+        {
+            auto allocator = std::make_shared<IO::StreamAllocator>("truncated");
+
+            Assert::ExpectException<Exceptions::ParserException>([&allocator]()
+            {
+                Parsers::Binary::Index index({ { 0, 1 } }, allocator);
+            });
+        }
+
+        TEST_METHOD(ParseEncoding)
+        {
+            auto allocator = std::make_shared<IO::StreamAllocator>("encoding");
+            auto size = std::experimental::filesystem::file_size("encoding/data/data.000");
+
+            // Looked up in the pages as they are, and decoded into sorted tables.
+            for (auto decode : { false, true })
+            {
+                Parsers::Binary::Encoding encoding(Parsers::Binary::Reference(IndexKey(), 0, 0, size), allocator, decode);
+
+                Assert::AreEqual(std::string("11111111111111111111111111111111"),
+                    encoding.findKey(FileHash(std::string("01010101010101010101010101010101"))).string());
+
+                auto info = encoding.findFileInfo(FileHash(std::string("02020202020202020202020202020202")));
+                Assert::AreEqual(256U, info.size);
+                Assert::AreEqual(2U, info.keys.size());
+                Assert::AreEqual(std::string("22222222222222222222222222222222"), info.keys[0].string());
+                Assert::AreEqual(std::string("33333333333333333333333333333333"), info.keys[1].string());
+
+                auto encoded = encoding.findEncodedFileInfo(FileKey(std::string("22222222222222222222222222222222")));
+                Assert::AreEqual(200U, encoded.size);
+                Assert::AreEqual(std::string("z"), encoded.params);
+
+                encoded = encoding.findEncodedFileInfo(FileKey(std::string("33333333333333333333333333333333")));
+                Assert::AreEqual(300U, encoded.size);
+                Assert::AreEqual(std::string(""), encoded.params);
+
+                Assert::ExpectException<Exceptions::HashDoesNotExistException>([&encoding]()
+                {
+                    encoding.findKey(FileHash(std::string("03030303030303030303030303030303")));
+                });
+            }
+        }
+
+        TEST_METHOD(OpenBatchInStorageOrder)
+        {
+            // Each file is 30 bytes of header, 9 bytes of BLTE header and its text.
+            auto first = 30U + 9U + 7U;
+
+            std::vector<std::pair<size_t, Parsers::Binary::Reference>> refs{
+                { 0, Parsers::Binary::Reference(IndexKey(), 1, first, 47) },
+                { 1, Parsers::Binary::Reference(IndexKey(), 0, 0, 46) },
+                { 2, Parsers::Binary::Reference(IndexKey(), 1, 0, 46) },
+                { 3, Parsers::Binary::Reference(IndexKey(), 7, 0, 46) },
+                { 4, Parsers::Binary::Reference(IndexKey(), 0, first, 47) } };
+
+            std::vector<size_t> order;
+            std::vector<std::string> texts;
+
+            auto allocator = std::make_shared<IO::StreamAllocator>("ordered");
+
+            auto failed = allocator->data(refs, [&](size_t i, std::shared_ptr<IO::Stream> stream)
+            {
+                order.push_back(i);
+                texts.emplace_back(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+            });
+
+            Assert::AreEqual(4U, order.size());
+            Assert::AreEqual(1U, order[0]);
+            Assert::AreEqual(4U, order[1]);
+            Assert::AreEqual(2U, order[2]);
+            Assert::AreEqual(0U, order[3]);
+
+            Assert::AreEqual(std::string("0 first"), texts[0]);
+            Assert::AreEqual(std::string("0 second"), texts[1]);
+            Assert::AreEqual(std::string("1 first"), texts[2]);
+            Assert::AreEqual(std::string("1 second"), texts[3]);
+
+            // There is no data.007.
+            Assert::AreEqual(1U, failed.size());
+            Assert::AreEqual(3U, failed[0]);
+
+            // Opened on the pool, the same files are opened and the same one fails.
+            auto pool = std::make_shared<ThreadPool>(2);
+            auto concurrent = std::make_shared<IO::StreamAllocator>("ordered", pool);
+            std::mutex mutex;
+            order.clear();
+
+            failed = concurrent->data(refs, [&](size_t i, std::shared_ptr<IO::Stream>)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(i);
+            }, true);
+
+            std::sort(order.begin(), order.end());
+
+            Assert::AreEqual(4U, order.size());
+            Assert::AreEqual(0U, order[0]);
+            Assert::AreEqual(4U, order[3]);
+            Assert::AreEqual(1U, failed.size());
+            Assert::AreEqual(3U, failed[0]);
+        }
+
+        TEST_METHOD(ParseTruncatedRoot)
+        {
+            // A block header announcing two records, followed by only one file data id.
+            std::string root("\x02\0\0\0\0\0\0\0\x02\0\0\0\x05\0\0\0", 16);
+            std::istringstream stream(root);
+
+            Assert::ExpectException<Exceptions::ParserException>([&stream, &root]()
+            {
+                Filesystem::Impl::WoWHandler handler(stream, root.size());
+            });
+        }
+
+        TEST_METHOD(ParseOverwatchRoot)
+        {
+            std::string root(
+                "#MD5|CHUNK_ID|FILENAME\n"
+                "0123456789abcdef0123456789abcdef|0|data/file.bin\n");
+            std::istringstream stream(root);
+
+            auto handler = Filesystem::HandlerRegistry::parse(ProgramCode::pro,
+                stream, root.size(), Filesystem::RootFilter(), nullptr);
+
+            Assert::AreEqual(std::string("0123456789abcdef0123456789abcdef"),
+                handler->findHash("DATA\\FILE.BIN").string());
+
+            std::string crlfRoot(
+                "#MD5|CHUNK_ID|FILENAME\r\n"
+                "0123456789abcdef0123456789abcdef|0|data/file.bin\r\n");
+            std::istringstream crlfStream(crlfRoot);
+
+            auto crlfHandler = Filesystem::HandlerRegistry::parse(ProgramCode::pro,
+                crlfStream, crlfRoot.size(), Filesystem::RootFilter(), nullptr);
+
+            Assert::AreEqual(std::string("0123456789abcdef0123456789abcdef"),
+                crlfHandler->findHash("DATA\\FILE.BIN").string());
+        }
+
+        TEST_METHOD(ParseUnsupportedRoot)
+        {
+            std::string mndx("MNDX\x01\0\0\0", 8);
+            std::istringstream mndxStream(mndx);
+
+            Assert::ExpectException<Exceptions::FilesystemException>([&mndxStream, &mndx]()
+            {
+                Filesystem::HandlerRegistry::parse(ProgramCode::hero,
+                    mndxStream, mndx.size(), Filesystem::RootFilter(), nullptr);
+            });
+
+            std::string tvfs("TVFS\x01\x26\x09\x09", 8);
+            std::istringstream tvfsStream(tvfs);
+
+            Assert::ExpectException<Exceptions::FilesystemException>([&tvfsStream, &tvfs]()
+            {
+                Filesystem::HandlerRegistry::parse(ProgramCode::pro,
+                    tvfsStream, tvfs.size(), Filesystem::RootFilter(), nullptr);
+            });
+        }
+
+        TEST_METHOD(ParseD3Root)
+        {
+            auto word = [](std::string &s, uint32_t value)
+            {
+                auto bytes = IO::Endian::write<IO::EndianType::Little, uint32_t>(value);
+                s.append(bytes.begin(), bytes.end());
+            };
+
+            auto hash = [](std::string &s, const char *hex)
+            {
+                FileHash key{ std::string(hex) };
+                s.append(key.begin(), key.end());
+            };
+
+            // A directory with one asset, one asset part and one named file.
+            std::string base;
+            word(base, 0xEAF1FE87);
+            word(base, 1);
+            hash(base, "10000000000000000000000000000000");
+            word(base, 100);
+            word(base, 1);
+            hash(base, "11000000000000000000000000000000");
+            word(base, 100);
+            word(base, 3);
+            word(base, 1);
+            hash(base, "12000000000000000000000000000000");
+            base.append("CoreTOC.dat", 12);
+
+            // A localized directory with one named file.
+            std::string text;
+            word(text, 0xEAF1FE87);
+            word(text, 0);
+            word(text, 0);
+            word(text, 1);
+            hash(text, "20000000000000000000000000000000");
+            text.append("Sub/Text.stl", 13);
+
+            std::map<FileHash, std::string> files;
+            files[FileHash(std::string("50000000000000000000000000000000"))] = base;
+            files[FileHash(std::string("51000000000000000000000000000000"))] = text;
+
+            std::string root;
+            word(root, 0x8007D0C4);
+            word(root, 2);
+            hash(root, "50000000000000000000000000000000");
+            root.append("Base", 5);
+            hash(root, "51000000000000000000000000000000");
+            root.append("enUS_Text", 10);
+
+            Filesystem::FileOpener open = [&files](const FileHash &key, size_t &size)
+            {
+                auto &file = files.at(key);
+                size = file.size();
+                return std::shared_ptr<std::istream>(std::make_shared<std::istringstream>(file));
+            };
+
+            std::istringstream stream(root);
+
+            auto handler = Filesystem::HandlerRegistry::parse(ProgramCode::d3,
+                stream, root.size(), Filesystem::RootFilter(), open);
+
+            Assert::AreEqual(std::string("12000000000000000000000000000000"),
+                handler->findHash("BASE\\CORETOC.DAT").string());
+            Assert::AreEqual(std::string("10000000000000000000000000000000"),
+                handler->findHash("BASE\\100").string());
+            Assert::AreEqual(std::string("11000000000000000000000000000000"),
+                handler->findHash("BASE\\100\\3").string());
+            Assert::AreEqual(std::string("10000000000000000000000000000000"),
+                handler->findHashById(100).string());
+            Assert::AreEqual(std::string("20000000000000000000000000000000"),
+                handler->findHash("ENUS_TEXT\\SUB\\TEXT.STL").string());
+
+            Filesystem::RootFilter german;
+            german.locales = Filesystem::Locale::deDE;
+
+            std::istringstream germanStream(root);
+
+            auto germanHandler = Filesystem::HandlerRegistry::parse(ProgramCode::d3,
+                germanStream, root.size(), german, open);
+
+            Assert::AreEqual(std::string("12000000000000000000000000000000"),
+                germanHandler->findHash("BASE\\CORETOC.DAT").string());
+
+            Assert::ExpectException<Exceptions::FilenameDoesNotExistException>([&germanHandler]()
+            {
+                germanHandler->findHash("ENUS_TEXT\\SUB\\TEXT.STL");
+            });
+        }
+
+        TEST_METHOD(FindFileVariantsForOneLocale)
+        {
+            ContainerOptions options;
+            options.rootFilter.locales = Filesystem::Locale::enUS;
+
+            auto container = std::make_unique<Container>(
+                R"(I:\World of Warcraft)",
+                R"(Data)", options);
+
+            auto variants = container->findFileVariants("SPELLS\\BONE_CYCLONE_STATE.M2");
+
+            Assert::IsFalse(variants.empty());
+
+            for (auto &variant : variants)
+            {
+                Assert::IsTrue((variant.locale & Filesystem::Locale::enUS) != 0);
+            }
+        }
+
 	};
 }
\ No newline at end of file
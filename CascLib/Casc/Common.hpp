@@ -54,6 +54,7 @@ namespace Casc
 
 // Helpers
 #include "Hex.hpp"
+#include "Key.hpp"
 
 #include "IO/Endian.hpp"
 
@@ -19,10 +19,15 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <experimental/filesystem>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <locale>
+#include <mutex>
 #include <numeric>
 #include <sstream>
 #include <string>
@@ -30,13 +35,17 @@
 #include <vector>
 
 #include "Common.hpp"
+#include "ContainerOptions.hpp"
 #include "Exceptions.hpp"
+#include "ThreadPool.hpp"
 
 #include "md5.hpp"
 
 #include "Filesystem/Root.hpp"
+#include "IO/BlockCache.hpp"
 #include "IO/Handler.hpp"
 #include "IO/Stream.hpp"
+#include "IO/Snapshot.hpp"
 #include "IO/StreamAllocator.hpp"
 #include "Parsers/Text/BuildInfo.hpp"
 #include "Parsers/Text/Configuration.hpp"
@@ -50,6 +59,14 @@ namespace Casc
 {
     /**
      * A container for a CASC archive.
+     *
+     * Once constructed, the container can be used from several threads at once
+     * without locking. The index and encoding tables are never modified after
+     * loading, data files are memory mapped and read by offset, and the block
+     * cache and the data file map have their own locks.
+     *
+     * The streams it returns are not shared; each stream should only be used
+     * by one thread at a time, but any number of streams can be open at once.
      */
     class Container
     {
@@ -57,34 +74,218 @@ namespace Casc
         typedef std::pair<Parsers::Text::EncodingBlock, std::vector<char>> descriptor_type;
 
     public:
-        std::shared_ptr<std::istream> openFileByKey(Hex key) const
+        std::shared_ptr<IO::Stream> openFileByKey(const FileKey &key) const
+        {
+            return allocator->data(index->find(IndexKey(key)));
+        }
+
+        std::shared_ptr<IO::Stream> openFileByKey(Hex key) const
         {
             return allocator->data(findFileLocation(key));
         }
 
-        std::shared_ptr<std::istream> openFileByHash(Hex hash) const
+        std::shared_ptr<IO::Stream> openFileByHash(const FileHash &hash) const
+        {
+            return openFileByKey(encoding->findKey(hash));
+        }
+
+        std::shared_ptr<IO::Stream> openFileByHash(Hex hash) const
         {
-            auto fi = encoding->findFileInfo(hash);
-            auto enc = encoding->findEncodedFileInfo(fi.keys.at(0));
-            return openFileByKey(enc.key);
+            return openFileByHash(FileHash(hash.begin(), hash.end()));
         }
 
-        std::shared_ptr<std::istream> openFileByName(std::string path) const
+        std::shared_ptr<IO::Stream> openFileByName(std::string path) const
         {
             auto hash = root->find(path);
             return openFileByHash(hash);
         }
 
+        std::shared_ptr<IO::Stream> openFileById(uint32_t id) const
+        {
+            return openFileByHash(root->findById(id));
+        }
+
+        /**
+         * Finds every file a filename refers to, one per set of locales and
+         * content flags that the root filter kept. Each can be opened with
+         * openFileByHash.
+         */
+        std::vector<Filesystem::FileVariant> findFileVariants(const std::string &path) const
+        {
+            return root->findAll(path);
+        }
+
+        /**
+         * Opens a file by key on a worker thread. The data file is read and the
+         * headers are parsed off the calling thread.
+         *
+         * The container must outlive the returned future.
+         */
+        std::future<std::shared_ptr<IO::Stream>> openFileAsync(const FileKey &key) const
+        {
+            return pool->submit([this, key]() { return openFileByKey(key); });
+        }
+
+        /**
+         * Opens a file by name on a worker thread. See openFileAsync.
+         */
+        std::future<std::shared_ptr<IO::Stream>> openFileAsync(const std::string &path) const
+        {
+            return pool->submit([this, path]() { return openFileByName(path); });
+        }
+
+        /**
+         * Opens a file on a worker thread and calls callback(stream, error) there
+         * when it is done. The stream is nullptr if an exception was thrown,
+         * and error holds the exception.
+         *
+         * The container must outlive the call to the callback.
+         */
+        template <typename Callback>
+        void openFileAsync(const FileKey &key, Callback callback) const
+        {
+            runAsync([this, key]() { return openFileByKey(key); }, callback);
+        }
+
+        /**
+         * Opens a file by name on a worker thread. See openFileAsync.
+         */
+        template <typename Callback>
+        void openFileAsync(const std::string &path, Callback callback) const
+        {
+            runAsync([this, path]() { return openFileByName(path); }, callback);
+        }
+
+        /**
+         * Opens and decodes a whole file on the worker threads.
+         *
+         * The container must outlive the returned future.
+         */
+        std::future<std::vector<char>> readAsync(const FileKey &key) const
+        {
+            return pool->submit([this, key]() { return openFileByKey(key)->readAll(); });
+        }
+
+        /**
+         * Opens and decodes a whole file by name on the worker threads. See readAsync.
+         */
+        std::future<std::vector<char>> readAsync(const std::string &path) const
+        {
+            return pool->submit([this, path]() { return openFileByName(path)->readAll(); });
+        }
+
+        /**
+         * Opens and decodes a whole file on the worker threads, then calls
+         * callback(data, error) on a worker thread. The data is empty if an
+         * exception was thrown, and error holds the exception.
+         *
+         * The container must outlive the call to the callback.
+         */
+        template <typename Callback>
+        void readAsync(const FileKey &key, Callback callback) const
+        {
+            runAsync([this, key]() { return openFileByKey(key)->readAll(); }, callback);
+        }
+
+        /**
+         * Opens and decodes a whole file by name on the worker threads. See readAsync.
+         */
+        template <typename Callback>
+        void readAsync(const std::string &path, Callback callback) const
+        {
+            runAsync([this, path]() { return openFileByName(path)->readAll(); }, callback);
+        }
+
+        /**
+         * Opens a batch of files by key, in the order they are stored in the
+         * data files, and calls callback(index, stream) for each of them.
+         * Returns the indices of the keys that couldn't be found or opened.
+         *
+         * If concurrent is true the callback is called from the container's
+         * worker threads, still roughly in storage order.
+         */
+        template <typename Callback>
+        std::vector<size_t> openFilesByKey(const std::vector<FileKey> &keys,
+            Callback callback, bool concurrent = false) const
+        {
+            return openFiles(keys.size(), [&](size_t i)
+            {
+                return index->find(IndexKey(keys[i]));
+            }, callback, concurrent);
+        }
+
+        /**
+         * Opens a batch of files by content hash. See openFilesByKey.
+         */
+        template <typename Callback>
+        std::vector<size_t> openFilesByHash(const std::vector<FileHash> &hashes,
+            Callback callback, bool concurrent = false) const
+        {
+            return openFiles(hashes.size(), [&](size_t i)
+            {
+                return index->find(IndexKey(encoding->findKey(hashes[i])));
+            }, callback, concurrent);
+        }
+
+        /**
+         * Opens a batch of files by name. See openFilesByKey.
+         */
+        template <typename Callback>
+        std::vector<size_t> openFilesByName(const std::vector<std::string> &paths,
+            Callback callback, bool concurrent = false) const
+        {
+            // The names are looked up together, which is much cheaper than
+            // one at a time for large batches.
+            std::vector<FileHash> hashes;
+            std::vector<bool> found(paths.size(), true);
+
+            for (auto i : root->find(paths, hashes))
+            {
+                found[i] = false;
+            }
+
+            return openFiles(paths.size(), [&](size_t i)
+            {
+                if (!found[i])
+                {
+                    throw Exceptions::FilenameDoesNotExistException(paths[i]);
+                }
+
+                return index->find(IndexKey(encoding->findKey(hashes[i])));
+            }, callback, concurrent);
+        }
+
+        /**
+         * The block cache counters. All zero when the cache is disabled.
+         */
+        IO::BlockCache::Statistics cacheStatistics() const
+        {
+            if (cache == nullptr)
+            {
+                return{ 0, 0, 0, 0 };
+            }
+
+            return cache->statistics();
+        }
+
     private:
         static const int BlteSignature = 0x45544C42;
         static const int DataHeaderSize = 30U;
-
         // The path of the game directory.
         std::string path;
 
         // The relative path of the data directory.
         std::string dataPath;
 
+        // The container settings.
+        ContainerOptions options;
+
+        // The worker threads.
+        std::shared_ptr<ThreadPool> pool;
+
+        // The decoded chunks shared by all streams.
+        std::shared_ptr<IO::BlockCache> cache;
+
         // The stream allocator.
         std::shared_ptr<IO::StreamAllocator> allocator;
 
@@ -109,6 +310,63 @@ namespace Casc
         // Filesystem root.
         std::shared_ptr<Filesystem::Root> root;
 
+        /**
+         * Runs a task on a worker thread and passes its result, or the
+         * exception it threw, to the callback.
+         */
+        template <typename Task, typename Callback>
+        void runAsync(Task task, Callback callback) const
+        {
+            pool->submit([task, callback]()
+            {
+                decltype(task()) result;
+
+                try
+                {
+                    result = task();
+                }
+                catch (...)
+                {
+                    callback(decltype(task())(), std::current_exception());
+                    return;
+                }
+
+                callback(std::move(result), std::exception_ptr());
+            });
+        }
+
+        /**
+         * Resolves a batch of files, sorts them by data file and offset,
+         * then opens them in that order.
+         */
+        template <typename Resolve, typename Callback>
+        std::vector<size_t> openFiles(size_t count, Resolve resolve, Callback callback, bool concurrent) const
+        {
+            std::vector<std::pair<size_t, Parsers::Binary::Reference>> refs;
+            std::vector<size_t> failed;
+
+            refs.reserve(count);
+
+            for (auto i = 0U; i < count; ++i)
+            {
+                try
+                {
+                    refs.emplace_back(i, resolve(i));
+                }
+                catch (Exceptions::CascException &)
+                {
+                    failed.push_back(i);
+                }
+            }
+
+            auto unopened = allocator->data(std::move(refs), callback, concurrent);
+            failed.insert(failed.end(), unopened.begin(), unopened.end());
+
+            std::sort(failed.begin(), failed.end());
+
+            return failed;
+        }
+
         /**
          * Finds the location of a file.
          */
@@ -117,22 +375,130 @@ namespace Casc
             return index->find(key.begin(), key.begin() + 9);
         }
 
+        /**
+         * Loads the index, encoding and root tables from a snapshot. Returns false
+         * if there is no usable snapshot, or if it was written for another build,
+         * other .idx files or another root filter.
+         */
+        bool loadSnapshot(const std::string &file, ProgramCode program)
+        {
+            try
+            {
+                IO::SnapshotReader reader(file);
+
+                if (reader.readString() != buildInfo.build(0).at("Build Key") ||
+                    reader.readMap<uint32_t, uint32_t>() != shadowMemory.versions() ||
+                    reader.read<uint32_t>() != options.rootFilter.locales ||
+                    reader.read<uint32_t>() != options.rootFilter.requiredFlags ||
+                    reader.read<uint32_t>() != options.rootFilter.excludedFlags)
+                {
+                    return false;
+                }
+
+                auto index = std::make_shared<Parsers::Binary::Index>(reader);
+                auto encoding = std::make_shared<Parsers::Binary::Encoding>(reader);
+                auto root = std::make_shared<Filesystem::Root>(program, reader);
+
+                // Pages that were never checked don't satisfy a container that checks them.
+                if (options.pageVerification != Parsers::Binary::PageVerification::Off &&
+                    encoding->pageVerification() == Parsers::Binary::PageVerification::Off)
+                {
+                    return false;
+                }
+
+                this->index = index;
+                this->encoding = encoding;
+                this->root = root;
+
+                return true;
+            }
+            catch (Exceptions::CascException &)
+            {
+                return false;
+            }
+        }
+
+        /**
+         * Writes the index, encoding and root tables to a snapshot. The file is
+         * written under a temporary name and then renamed, so that other
+         * processes never map a partial snapshot. Failures are ignored; the
+         * tables are parsed again on the next start.
+         */
+        void saveSnapshot(const std::string &file) const
+        {
+            namespace fs = std::experimental::filesystem;
+
+            auto temporary = file + "." +
+                std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+            std::error_code error;
+
+            try
+            {
+                IO::SnapshotWriter writer(temporary);
+
+                writer.write(buildInfo.build(0).at("Build Key"));
+                writer.write(shadowMemory.versions());
+                writer.write(options.rootFilter.locales);
+                writer.write(options.rootFilter.requiredFlags);
+                writer.write(options.rootFilter.excludedFlags);
+
+                index->save(writer);
+                encoding->save(writer);
+                root->save(writer);
+
+                writer.close();
+
+                fs::rename(temporary, file, error);
+
+                if (!error)
+                {
+                    return;
+                }
+            }
+            catch (Exceptions::CascException &)
+            {
+            }
+
+            fs::remove(temporary, error);
+        }
+
     public:
         /**
          * Constructor.
          */
-        Container(const std::string path, const std::string dataPath) :
-            allocator(new IO::StreamAllocator(path + "\\" + dataPath)),
+        Container(const std::string path, const std::string dataPath,
+            const ContainerOptions &options = ContainerOptions()) :
+            options(options),
+            pool(std::make_shared<ThreadPool>(options.threads)),
+            cache(options.cacheSize > 0 ? std::make_shared<IO::BlockCache>(options.cacheSize) : nullptr),
+            allocator(new IO::StreamAllocator(path + "\\" + dataPath, pool, cache,
+                options.dataSource, options.verification,
+                options.keyFile.empty() ? nullptr : std::make_shared<Crypto::KeyStore>(options.keyFile))),
             buildInfo(path + "\\.build.info"),
             buildConfig(allocator->config<true, false>(buildInfo.build(0).at("Build Key"))),
             cdnConfig(allocator->config<true, false>(buildInfo.build(0).at("CDN Key"))),
-            shadowMemory(allocator->shmem<true, false>()),
-            index(new Parsers::Binary::Index(shadowMemory.versions(), allocator)),
-            encoding(new Parsers::Binary::Encoding(
-                index->find(Hex(buildConfig["encoding"].back().substr(0, 18U))), allocator)),
-            root(new Filesystem::Root(getProgramCode(buildConfig["build-uid"].front()),
-                buildConfig["root"].front(), encoding, index, allocator))
+            shadowMemory(allocator->shmem<true, false>())
         {
+            auto program = getProgramCode(buildConfig["build-uid"].front());
+            auto snapshot = options.snapshot && options.decodeEncoding;
+            auto snapshotPath = path + "\\.casclib.snapshot";
+
+            if (snapshot && loadSnapshot(snapshotPath, program))
+            {
+                return;
+            }
+
+            index = std::make_shared<Parsers::Binary::Index>(shadowMemory.versions(), allocator, pool);
+            encoding = std::make_shared<Parsers::Binary::Encoding>(
+                index->find(IndexKey(buildConfig["encoding"].back())), allocator,
+                options.decodeEncoding, options.pageVerification, pool);
+            root = std::make_shared<Filesystem::Root>(program,
+                FileHash(buildConfig["root"].front()), encoding, index, allocator, options.rootFilter);
+
+            if (snapshot)
+            {
+                saveSnapshot(snapshotPath);
+            }
         }
 
         /**
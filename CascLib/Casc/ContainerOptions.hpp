@@ -0,0 +1,75 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+#include "IO/DataSource.hpp"
+#include "IO/Verification.hpp"
+#include "Filesystem/RootFilter.hpp"
+#include "Parsers/Binary/PageVerification.hpp"
+
+namespace Casc
+{
+    /**
+     * Settings for a container.
+     */
+    struct ContainerOptions
+    {
+        // The number of worker threads used for loading and decoding.
+        // Zero uses one thread per hardware thread.
+        size_t threads = 0;
+
+        // Decodes the encoding tables into sorted arrays at startup
+        // instead of parsing a 4 KiB page on every lookup.
+        bool decodeEncoding = true;
+
+        // When the MD5 of the encoding table pages is checked.
+        Parsers::Binary::PageVerification pageVerification = Parsers::Binary::PageVerification::LazyOnce;
+
+        // The number of decoded bytes kept in the block cache shared by all
+        // streams of the container. Zero disables the cache.
+        size_t cacheSize = 0;
+
+        // How the data files are read. Memory mapping is the default;
+        // File reads by offset instead, for systems where mapping many
+        // large data files is undesirable.
+        IO::DataSourceType dataSource = IO::DataSourceType::MemoryMapped;
+
+        // How much of each opened file is checked against its MD5 checksums.
+        // Checking the block table costs one MD5 of a few hundred bytes per open;
+        // full verification also hashes every chunk as it is first read.
+        IO::Verification verification = IO::Verification::Header;
+
+        // Keeps a snapshot of the parsed index, encoding and root tables in the
+        // game directory, and maps it instead of parsing the tables again while
+        // the build and the .idx files are unchanged. Needs decodeEncoding.
+        bool snapshot = false;
+
+        // The root blocks that are loaded. Dropping unused locales and content
+        // flags saves memory and load time; the dropped files can't be found by name.
+        Filesystem::RootFilter rootFilter;
+
+        // A key file with the keys for encrypted files, one key name and key
+        // in hex per line. Without one, reading encrypted chunks throws.
+        std::string keyFile;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,499 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CASC_MD5_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit instructions beyond the compiler's target in functions
+// marked for them. These are only called once the processor is known to have them.
+#if defined(CASC_MD5_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CASC_MD5_TARGET(isa) __attribute__((target(isa)))
+#define CASC_MD5_FLATTEN __attribute__((flatten))
+#else
+#define CASC_MD5_TARGET(isa)
+#define CASC_MD5_FLATTEN
+#endif
+
+namespace Casc
+{
+    namespace Crypto
+    {
+        namespace Impl
+        {
+            /**
+             * One MD5 stream in a plain 32-bit integer.
+             */
+            struct ScalarLanes
+            {
+                typedef uint32_t Vector;
+
+                static const size_t Count = 1;
+
+                static void set(Vector &r, uint32_t value) { r = value; }
+                static void load(Vector &r, const uint32_t *values) { r = values[0]; }
+                static void store(uint32_t *values, const Vector &v) { values[0] = v; }
+                static void add(Vector &r, const Vector &a, const Vector &b) { r = a + b; }
+                static void f(Vector &r, const Vector &b, const Vector &c, const Vector &d) { r = d ^ (b & (c ^ d)); }
+                static void g(Vector &r, const Vector &b, const Vector &c, const Vector &d) { r = c ^ (d & (b ^ c)); }
+                static void h(Vector &r, const Vector &b, const Vector &c, const Vector &d) { r = b ^ c ^ d; }
+                static void i(Vector &r, const Vector &b, const Vector &c, const Vector &d) { r = c ^ (b | ~d); }
+
+                template <int S>
+                static void rotate(Vector &r, const Vector &a) { r = (a << S) | (a >> (32 - S)); }
+            };
+
+#if defined(CASC_MD5_X86)
+            /**
+             * Four MD5 streams in an SSE2 register.
+             */
+            struct Sse2Lanes
+            {
+                typedef __m128i Vector;
+
+                static const size_t Count = 4;
+
+                static void set(Vector &r, uint32_t value) { r = _mm_set1_epi32(int(value)); }
+                static void load(Vector &r, const uint32_t *values) { r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)); }
+                static void store(uint32_t *values, const Vector &v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(values), v); }
+                static void add(Vector &r, const Vector &a, const Vector &b) { r = _mm_add_epi32(a, b); }
+
+                static void f(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d)));
+                }
+
+                static void g(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm_xor_si128(c, _mm_and_si128(d, _mm_xor_si128(b, c)));
+                }
+
+                static void h(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm_xor_si128(_mm_xor_si128(b, c), d);
+                }
+
+                static void i(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, _mm_set1_epi32(-1))));
+                }
+
+                template <int S>
+                static void rotate(Vector &r, const Vector &a)
+                {
+                    r = _mm_or_si128(_mm_slli_epi32(a, S), _mm_srli_epi32(a, 32 - S));
+                }
+            };
+
+            /**
+             * Eight MD5 streams in an AVX2 register.
+             */
+            struct Avx2Lanes
+            {
+                typedef __m256i Vector;
+
+                static const size_t Count = 8;
+
+                CASC_MD5_TARGET("avx2") static void set(Vector &r, uint32_t value) { r = _mm256_set1_epi32(int(value)); }
+                CASC_MD5_TARGET("avx2") static void load(Vector &r, const uint32_t *values) { r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)); }
+                CASC_MD5_TARGET("avx2") static void store(uint32_t *values, const Vector &v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(values), v); }
+                CASC_MD5_TARGET("avx2") static void add(Vector &r, const Vector &a, const Vector &b) { r = _mm256_add_epi32(a, b); }
+
+                CASC_MD5_TARGET("avx2") static void f(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+                }
+
+                CASC_MD5_TARGET("avx2") static void g(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm256_xor_si256(c, _mm256_and_si256(d, _mm256_xor_si256(b, c)));
+                }
+
+                CASC_MD5_TARGET("avx2") static void h(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+                }
+
+                CASC_MD5_TARGET("avx2") static void i(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm256_xor_si256(c, _mm256_or_si256(b, _mm256_xor_si256(d, _mm256_set1_epi32(-1))));
+                }
+
+                template <int S>
+                CASC_MD5_TARGET("avx2") static void rotate(Vector &r, const Vector &a)
+                {
+                    r = _mm256_or_si256(_mm256_slli_epi32(a, S), _mm256_srli_epi32(a, 32 - S));
+                }
+            };
+
+            /**
+             * Sixteen MD5 streams in an AVX-512 register. Each round function
+             * is a single ternary logic instruction.
+             */
+            struct Avx512Lanes
+            {
+                typedef __m512i Vector;
+
+                static const size_t Count = 16;
+
+                CASC_MD5_TARGET("avx512f") static void set(Vector &r, uint32_t value) { r = _mm512_set1_epi32(int(value)); }
+                CASC_MD5_TARGET("avx512f") static void load(Vector &r, const uint32_t *values) { r = _mm512_loadu_si512(values); }
+                CASC_MD5_TARGET("avx512f") static void store(uint32_t *values, const Vector &v) { _mm512_storeu_si512(values, v); }
+                CASC_MD5_TARGET("avx512f") static void add(Vector &r, const Vector &a, const Vector &b) { r = _mm512_add_epi32(a, b); }
+
+                CASC_MD5_TARGET("avx512f") static void f(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm512_ternarylogic_epi32(b, c, d, 0xCA);
+                }
+
+                CASC_MD5_TARGET("avx512f") static void g(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm512_ternarylogic_epi32(b, c, d, 0xE4);
+                }
+
+                CASC_MD5_TARGET("avx512f") static void h(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm512_ternarylogic_epi32(b, c, d, 0x96);
+                }
+
+                CASC_MD5_TARGET("avx512f") static void i(Vector &r, const Vector &b, const Vector &c, const Vector &d)
+                {
+                    r = _mm512_ternarylogic_epi32(b, c, d, 0x39);
+                }
+
+                template <int S>
+                CASC_MD5_TARGET("avx512f") static void rotate(Vector &r, const Vector &a)
+                {
+                    r = _mm512_rol_epi32(a, S);
+                }
+            };
+#endif
+
+            /**
+             * MD5 of up to Lanes::Count independent buffers, one per lane. Each lane
+             * steps through its own blocks; a lane that runs out hashes zeros until
+             * the longest buffer is done, so similar lengths should be grouped.
+             */
+            template <typename Lanes>
+            class LaneMD5
+            {
+            private:
+                typedef typename Lanes::Vector Vector;
+
+                /**
+                 * One of the 64 steps: a = b + ((a + fn(b, c, d) + x + t) <<< S).
+                 */
+                template <int S>
+                static void step(Vector &a, const Vector &b, Vector &v, const Vector &x, uint32_t t)
+                {
+                    Vector k;
+                    Lanes::set(k, t);
+                    Lanes::add(v, v, x);
+                    Lanes::add(v, v, k);
+                    Lanes::add(v, v, a);
+                    Lanes::template rotate<S>(v, v);
+                    Lanes::add(a, v, b);
+                }
+
+                template <int S>
+                static void ff(Vector &a, const Vector &b, const Vector &c, const Vector &d, const Vector &x, uint32_t t)
+                {
+                    Vector v;
+                    Lanes::f(v, b, c, d);
+                    step<S>(a, b, v, x, t);
+                }
+
+                template <int S>
+                static void gg(Vector &a, const Vector &b, const Vector &c, const Vector &d, const Vector &x, uint32_t t)
+                {
+                    Vector v;
+                    Lanes::g(v, b, c, d);
+                    step<S>(a, b, v, x, t);
+                }
+
+                template <int S>
+                static void hh(Vector &a, const Vector &b, const Vector &c, const Vector &d, const Vector &x, uint32_t t)
+                {
+                    Vector v;
+                    Lanes::h(v, b, c, d);
+                    step<S>(a, b, v, x, t);
+                }
+
+                template <int S>
+                static void ii(Vector &a, const Vector &b, const Vector &c, const Vector &d, const Vector &x, uint32_t t)
+                {
+                    Vector v;
+                    Lanes::i(v, b, c, d);
+                    step<S>(a, b, v, x, t);
+                }
+
+                /**
+                 * Adds one 64-byte block of every lane to the state.
+                 */
+                static void transform(Vector state[4], const Vector x[16])
+                {
+                    Vector a = state[0], b = state[1], c = state[2], d = state[3];
+
+                    // Round 1
+                    ff<7>(a, b, c, d, x[0], 0xd76aa478);
+                    ff<12>(d, a, b, c, x[1], 0xe8c7b756);
+                    ff<17>(c, d, a, b, x[2], 0x242070db);
+                    ff<22>(b, c, d, a, x[3], 0xc1bdceee);
+                    ff<7>(a, b, c, d, x[4], 0xf57c0faf);
+                    ff<12>(d, a, b, c, x[5], 0x4787c62a);
+                    ff<17>(c, d, a, b, x[6], 0xa8304613);
+                    ff<22>(b, c, d, a, x[7], 0xfd469501);
+                    ff<7>(a, b, c, d, x[8], 0x698098d8);
+                    ff<12>(d, a, b, c, x[9], 0x8b44f7af);
+                    ff<17>(c, d, a, b, x[10], 0xffff5bb1);
+                    ff<22>(b, c, d, a, x[11], 0x895cd7be);
+                    ff<7>(a, b, c, d, x[12], 0x6b901122);
+                    ff<12>(d, a, b, c, x[13], 0xfd987193);
+                    ff<17>(c, d, a, b, x[14], 0xa679438e);
+                    ff<22>(b, c, d, a, x[15], 0x49b40821);
+
+                    // Round 2
+                    gg<5>(a, b, c, d, x[1], 0xf61e2562);
+                    gg<9>(d, a, b, c, x[6], 0xc040b340);
+                    gg<14>(c, d, a, b, x[11], 0x265e5a51);
+                    gg<20>(b, c, d, a, x[0], 0xe9b6c7aa);
+                    gg<5>(a, b, c, d, x[5], 0xd62f105d);
+                    gg<9>(d, a, b, c, x[10], 0x02441453);
+                    gg<14>(c, d, a, b, x[15], 0xd8a1e681);
+                    gg<20>(b, c, d, a, x[4], 0xe7d3fbc8);
+                    gg<5>(a, b, c, d, x[9], 0x21e1cde6);
+                    gg<9>(d, a, b, c, x[14], 0xc33707d6);
+                    gg<14>(c, d, a, b, x[3], 0xf4d50d87);
+                    gg<20>(b, c, d, a, x[8], 0x455a14ed);
+                    gg<5>(a, b, c, d, x[13], 0xa9e3e905);
+                    gg<9>(d, a, b, c, x[2], 0xfcefa3f8);
+                    gg<14>(c, d, a, b, x[7], 0x676f02d9);
+                    gg<20>(b, c, d, a, x[12], 0x8d2a4c8a);
+
+                    // Round 3
+                    hh<4>(a, b, c, d, x[5], 0xfffa3942);
+                    hh<11>(d, a, b, c, x[8], 0x8771f681);
+                    hh<16>(c, d, a, b, x[11], 0x6d9d6122);
+                    hh<23>(b, c, d, a, x[14], 0xfde5380c);
+                    hh<4>(a, b, c, d, x[1], 0xa4beea44);
+                    hh<11>(d, a, b, c, x[4], 0x4bdecfa9);
+                    hh<16>(c, d, a, b, x[7], 0xf6bb4b60);
+                    hh<23>(b, c, d, a, x[10], 0xbebfbc70);
+                    hh<4>(a, b, c, d, x[13], 0x289b7ec6);
+                    hh<11>(d, a, b, c, x[0], 0xeaa127fa);
+                    hh<16>(c, d, a, b, x[3], 0xd4ef3085);
+                    hh<23>(b, c, d, a, x[6], 0x04881d05);
+                    hh<4>(a, b, c, d, x[9], 0xd9d4d039);
+                    hh<11>(d, a, b, c, x[12], 0xe6db99e5);
+                    hh<16>(c, d, a, b, x[15], 0x1fa27cf8);
+                    hh<23>(b, c, d, a, x[2], 0xc4ac5665);
+
+                    // Round 4
+                    ii<6>(a, b, c, d, x[0], 0xf4292244);
+                    ii<10>(d, a, b, c, x[7], 0x432aff97);
+                    ii<15>(c, d, a, b, x[14], 0xab9423a7);
+                    ii<21>(b, c, d, a, x[5], 0xfc93a039);
+                    ii<6>(a, b, c, d, x[12], 0x655b59c3);
+                    ii<10>(d, a, b, c, x[3], 0x8f0ccc92);
+                    ii<15>(c, d, a, b, x[10], 0xffeff47d);
+                    ii<21>(b, c, d, a, x[1], 0x85845dd1);
+                    ii<6>(a, b, c, d, x[8], 0x6fa87e4f);
+                    ii<10>(d, a, b, c, x[15], 0xfe2ce6e0);
+                    ii<15>(c, d, a, b, x[6], 0xa3014314);
+                    ii<21>(b, c, d, a, x[13], 0x4e0811a1);
+                    ii<6>(a, b, c, d, x[4], 0xf7537e82);
+                    ii<10>(d, a, b, c, x[11], 0xbd3af235);
+                    ii<15>(c, d, a, b, x[2], 0x2ad7d2bb);
+                    ii<21>(b, c, d, a, x[9], 0xeb86d391);
+
+                    Lanes::add(state[0], state[0], a);
+                    Lanes::add(state[1], state[1], b);
+                    Lanes::add(state[2], state[2], c);
+                    Lanes::add(state[3], state[3], d);
+                }
+
+                /**
+                 * Reads a little endian word.
+                 */
+                static uint32_t word(const unsigned char *p)
+                {
+                    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+                }
+
+            public:
+                /**
+                 * Hashes count buffers, at most Lanes::Count, into digests.
+                 */
+                static void hash(const std::pair<const char*, size_t> *buffers,
+                    std::array<unsigned char, 16> *digests, size_t count)
+                {
+                    static const unsigned char zeros[64] = {};
+
+                    // The whole blocks are read in place; the rest of the data and
+                    // the padding go into one or two blocks at the end.
+                    struct Lane
+                    {
+                        const unsigned char *data = zeros;
+                        size_t whole = 0;
+                        size_t blocks = 0;
+                        unsigned char tail[128];
+                    };
+
+                    Lane lanes[Lanes::Count];
+                    size_t blocks = 0;
+
+                    for (size_t l = 0; l < count; ++l)
+                    {
+                        auto &lane = lanes[l];
+                        auto size = buffers[l].second;
+                        auto rest = size % 64;
+
+                        lane.data = reinterpret_cast<const unsigned char*>(buffers[l].first);
+                        lane.whole = size / 64;
+                        lane.blocks = lane.whole + (rest < 56 ? 1 : 2);
+
+                        auto end = (lane.blocks - lane.whole) * 64;
+
+                        if (rest > 0)
+                        {
+                            std::memcpy(lane.tail, lane.data + lane.whole * 64, rest);
+                        }
+
+                        std::memset(lane.tail + rest, 0, end - rest);
+                        lane.tail[rest] = 0x80;
+
+                        for (size_t i = 0; i < 8; ++i)
+                        {
+                            lane.tail[end - 8 + i] = static_cast<unsigned char>(uint64_t(size) * 8 >> (8 * i));
+                        }
+
+                        blocks = std::max(blocks, lane.blocks);
+                    }
+
+                    Vector state[4];
+                    Lanes::set(state[0], 0x67452301);
+                    Lanes::set(state[1], 0xefcdab89);
+                    Lanes::set(state[2], 0x98badcfe);
+                    Lanes::set(state[3], 0x10325476);
+
+                    uint32_t words[16][Lanes::Count];
+                    uint32_t values[4][Lanes::Count];
+                    Vector x[16];
+
+                    for (size_t block = 0; block < blocks; ++block)
+                    {
+                        bool finished = false;
+
+                        for (size_t l = 0; l < Lanes::Count; ++l)
+                        {
+                            auto &lane = lanes[l];
+                            auto p = block < lane.whole ? lane.data + block * 64 :
+                                block < lane.blocks ? lane.tail + (block - lane.whole) * 64 : zeros;
+
+                            for (size_t w = 0; w < 16; ++w)
+                            {
+                                words[w][l] = word(p + w * 4);
+                            }
+
+                            finished |= lane.blocks == block + 1;
+                        }
+
+                        for (size_t w = 0; w < 16; ++w)
+                        {
+                            Lanes::load(x[w], words[w]);
+                        }
+
+                        transform(state, x);
+
+                        if (!finished)
+                        {
+                            continue;
+                        }
+
+                        for (size_t s = 0; s < 4; ++s)
+                        {
+                            Lanes::store(values[s], state[s]);
+                        }
+
+                        for (size_t l = 0; l < count; ++l)
+                        {
+                            if (lanes[l].blocks != block + 1)
+                            {
+                                continue;
+                            }
+
+                            for (size_t s = 0; s < 4; ++s)
+                            {
+                                for (size_t i = 0; i < 4; ++i)
+                                {
+                                    digests[l][s * 4 + i] = static_cast<unsigned char>(values[s][l] >> (8 * i));
+                                }
+                            }
+                        }
+                    }
+                }
+            };
+
+            /**
+             * Hashes one buffer without vector instructions.
+             */
+            inline void md5Scalar(const std::pair<const char*, size_t> *buffers,
+                std::array<unsigned char, 16> *digests, size_t count)
+            {
+                LaneMD5<ScalarLanes>::hash(buffers, digests, count);
+            }
+
+#if defined(CASC_MD5_X86)
+            /**
+             * Hashes up to one buffer per lane. The AVX2 and AVX-512 versions are compiled
+             * for their instruction set, with everything they call inlined.
+             */
+            inline void md5Sse2(const std::pair<const char*, size_t> *buffers,
+                std::array<unsigned char, 16> *digests, size_t count)
+            {
+                LaneMD5<Sse2Lanes>::hash(buffers, digests, count);
+            }
+
+            CASC_MD5_TARGET("avx2") CASC_MD5_FLATTEN
+            inline void md5Avx2(const std::pair<const char*, size_t> *buffers,
+                std::array<unsigned char, 16> *digests, size_t count)
+            {
+                LaneMD5<Avx2Lanes>::hash(buffers, digests, count);
+            }
+
+            CASC_MD5_TARGET("avx512f") CASC_MD5_FLATTEN
+            inline void md5Avx512(const std::pair<const char*, size_t> *buffers,
+                std::array<unsigned char, 16> *digests, size_t count)
+            {
+                LaneMD5<Avx512Lanes>::hash(buffers, digests, count);
+            }
+#endif
+        }
+    }
+}
\ No newline at end of file
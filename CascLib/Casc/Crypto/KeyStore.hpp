@@ -0,0 +1,172 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+#include "../Exceptions.hpp"
+#include "../Key.hpp"
+#include "Salsa20.hpp"
+
+namespace Casc
+{
+    namespace Crypto
+    {
+        /**
+         * The keys encrypted blocks are decrypted with, by key name. Keys are
+         * kept expanded, so opening an encrypted block only sets the nonce.
+         */
+        class KeyStore
+        {
+            // The expanded keys, by key name.
+            std::map<uint64_t, Salsa20::State> keys;
+
+            /**
+             * Parses a hex number of up to 16 digits.
+             */
+            static uint64_t parseName(const std::string &str)
+            {
+                if (str.empty() || str.size() > 16)
+                {
+                    throw Exceptions::ParserException("Invalid key name in key file.");
+                }
+
+                uint64_t name = 0;
+
+                for (auto c : str)
+                {
+                    if (!std::isxdigit(static_cast<unsigned char>(c)))
+                    {
+                        throw Exceptions::ParserException("Invalid key name in key file.");
+                    }
+
+                    auto digit = std::toupper(static_cast<unsigned char>(c));
+
+                    name = (name << 4) | uint64_t(digit <= '9' ? digit - '0' : digit - 'A' + 10);
+                }
+
+                return name;
+            }
+
+        public:
+            /**
+             * Default constructor. The store is empty.
+             */
+            KeyStore()
+            {
+
+            }
+
+            /**
+             * Constructor. Loads the keys from a key file.
+             */
+            KeyStore(const std::string &path)
+            {
+                std::ifstream stream(path);
+
+                if (stream.fail())
+                {
+                    throw Exceptions::FileNotFoundException(path);
+                }
+
+                load(stream);
+            }
+
+            /**
+             * Adds a 16 byte key, or replaces the key with the same name.
+             */
+            void add(uint64_t name, const Key<16> &key)
+            {
+                keys[name] = Salsa20::expand(key.data(), key.size());
+            }
+
+            /**
+             * Loads keys from a key file. Each line holds a key name, as a hex number,
+             * and the key in hex, separated by spaces, tabs, ',', ';' or '='. Empty
+             * lines and text after '#' are ignored.
+             */
+            void load(std::istream &stream)
+            {
+                std::string line;
+
+                while (std::getline(stream, line))
+                {
+                    line = line.substr(0, line.find('#'));
+
+                    for (auto &c : line)
+                    {
+                        if (c == ',' || c == ';' || c == '=' || c == '\t' || c == '\r')
+                        {
+                            c = ' ';
+                        }
+                    }
+
+                    auto first = line.find_first_not_of(' ');
+
+                    if (first == std::string::npos)
+                    {
+                        continue;
+                    }
+
+                    auto last = line.find(' ', first);
+                    auto keyFirst = line.find_first_not_of(' ', last);
+
+                    if (last == std::string::npos || keyFirst == std::string::npos)
+                    {
+                        throw Exceptions::ParserException("A key file line has no key.");
+                    }
+
+                    auto keyLast = std::min(line.find(' ', keyFirst), line.size());
+
+                    if (keyLast - keyFirst != 32)
+                    {
+                        throw Exceptions::ParserException("Invalid key in key file.");
+                    }
+
+                    add(parseName(line.substr(first, last - first)), Key<16>(line.substr(keyFirst, 32)));
+                }
+            }
+
+            /**
+             * Finds the expanded key with the given name, or returns null.
+             */
+            const Salsa20::State *find(uint64_t name) const
+            {
+                auto it = keys.find(name);
+
+                return it != keys.end() ? &it->second : nullptr;
+            }
+
+            /**
+             * The number of keys.
+             */
+            size_t size() const
+            {
+                return keys.size();
+            }
+        };
+    }
+}
\ No newline at end of file
@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <utility>
+#include <vector>
+
 #include "../lookup3.hpp"
 
 namespace Casc
@@ -101,5 +104,31 @@ namespace Casc
 
             return hash;
         }
+
+        /**
+         * Computes the lookup3 hash pairs of several independent buffers, in order.
+         *
+         * lookup3 is a single dependency chain per buffer, and short names don't
+         * keep vector lanes busy for long enough to pay for transposing them, so
+         * the buffers are hashed back to back in one tight loop.
+         */
+        inline std::vector<std::pair<uint32_t, uint32_t>> lookup3Many(
+            const std::vector<std::pair<const char*, size_t>> &buffers,
+            const std::pair<uint32_t, uint32_t> &init = { 0, 0 })
+        {
+            std::vector<std::pair<uint32_t, uint32_t>> hashes(buffers.size());
+
+            for (auto i = 0U; i < buffers.size(); ++i)
+            {
+                auto pc = init.first;
+                auto pb = init.second;
+
+                hashlittle2(buffers[i].first, buffers[i].second, &pc, &pb);
+
+                hashes[i] = std::make_pair(pc, pb);
+            }
+
+            return hashes;
+        }
     }
 }
\ No newline at end of file
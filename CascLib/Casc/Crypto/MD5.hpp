@@ -19,7 +19,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #include "../md5.hpp"
+#include "Impl/MD5Lanes.hpp"
 
 namespace Casc
 {
@@ -41,5 +52,162 @@ namespace Casc
         {
             return MD5(begin, end).hexdigest();
         }
+    
+        /**
+         * The instruction sets used to hash several buffers at once, narrowest first.
+         */
+        enum class SimdLevel
+        {
+            // One buffer at a time.
+            Scalar,
+
+            // Four buffers at a time.
+            Sse2,
+
+            // Eight buffers at a time.
+            Avx2,
+
+            // Sixteen buffers at a time.
+            Avx512
+        };
+
+        /**
+         * The widest instruction set supported by the processor and the system.
+         * Checked once.
+         */
+        inline SimdLevel simdLevel()
+        {
+            static const SimdLevel level = []()
+            {
+#if defined(CASC_MD5_X86) && defined(_MSC_VER)
+                int info[4];
+
+                __cpuid(info, 0);
+                auto leaves = info[0];
+
+                __cpuid(info, 1);
+
+                // The system has to save the wider registers as well.
+                if (leaves < 7 || (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+                {
+                    return SimdLevel::Sse2;
+                }
+
+                auto xcr = _xgetbv(0);
+
+                __cpuidex(info, 7, 0);
+
+                if ((info[1] & (1 << 16)) != 0 && (xcr & 0xE6) == 0xE6)
+                {
+                    return SimdLevel::Avx512;
+                }
+
+                if ((info[1] & (1 << 5)) != 0 && (xcr & 0x06) == 0x06)
+                {
+                    return SimdLevel::Avx2;
+                }
+
+                return SimdLevel::Sse2;
+#elif defined(CASC_MD5_X86)
+                if (__builtin_cpu_supports("avx512f"))
+                {
+                    return SimdLevel::Avx512;
+                }
+
+                if (__builtin_cpu_supports("avx2"))
+                {
+                    return SimdLevel::Avx2;
+                }
+
+                return SimdLevel::Sse2;
+#else
+                return SimdLevel::Scalar;
+#endif
+            }();
+
+            return level;
+        }
+
+        /**
+         * Computes the raw MD5 digests of several independent buffers, in order.
+         * The buffers are hashed in parallel lanes of the widest instruction set
+         * up to the given level that the processor supports.
+         */
+        inline std::vector<std::array<unsigned char, 16>> md5Many(
+            const std::vector<std::pair<const char*, size_t>> &buffers, SimdLevel level = SimdLevel::Avx512)
+        {
+            level = std::min(level, simdLevel());
+
+            std::vector<std::array<unsigned char, 16>> digests(buffers.size());
+
+            // Buffers of similar length share a pass so few lanes hash padding.
+            std::vector<size_t> order(buffers.size());
+            std::iota(order.begin(), order.end(), size_t(0));
+            std::stable_sort(order.begin(), order.end(), [&buffers](size_t a, size_t b)
+            {
+                return buffers[a].second > buffers[b].second;
+            });
+
+            std::pair<const char*, size_t> group[16];
+            std::array<unsigned char, 16> results[16];
+
+            auto lanes = [](SimdLevel level) -> size_t
+            {
+                return level == SimdLevel::Avx512 ? 16 : level == SimdLevel::Avx2 ? 8 : level == SimdLevel::Sse2 ? 4 : 1;
+            };
+
+            for (size_t i = 0; i < order.size();)
+            {
+                auto remaining = order.size() - i;
+                auto use = level;
+
+                // The last few buffers don't need the widest registers.
+                while (use > SimdLevel::Sse2 && remaining <= lanes(use) / 2)
+                {
+                    use = static_cast<SimdLevel>(static_cast<int>(use) - 1);
+                }
+
+                if (remaining == 1)
+                {
+                    use = SimdLevel::Scalar;
+                }
+
+                auto count = std::min(remaining, lanes(use));
+
+                for (size_t k = 0; k < count; ++k)
+                {
+                    group[k] = buffers[order[i + k]];
+                }
+
+                switch (use)
+                {
+#if defined(CASC_MD5_X86)
+                case SimdLevel::Avx512:
+                    Impl::md5Avx512(group, results, count);
+                    break;
+
+                case SimdLevel::Avx2:
+                    Impl::md5Avx2(group, results, count);
+                    break;
+
+                case SimdLevel::Sse2:
+                    Impl::md5Sse2(group, results, count);
+                    break;
+#endif
+                default:
+                    Impl::md5Scalar(group, results, count);
+                    break;
+                }
+
+                for (size_t k = 0; k < count; ++k)
+                {
+                    digests[order[i + k]] = results[k];
+                }
+
+                i += count;
+            }
+
+            return digests;
+        }
     }
 }
\ No newline at end of file
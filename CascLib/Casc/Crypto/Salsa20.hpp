@@ -0,0 +1,187 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../Exceptions.hpp"
+#include "../IO/Endian.hpp"
+
+namespace Casc
+{
+    namespace Crypto
+    {
+        /**
+         * The Salsa20/20 stream cipher. The key stream can be applied at any
+         * offset, so encrypted data can be decrypted piecewise and out of order.
+         */
+        class Salsa20
+        {
+        public:
+            // The number of key stream bytes made at a time.
+            static const size_t BlockSize = 64U;
+
+            // The input words for a key, without the nonce and the block counter.
+            typedef std::array<uint32_t, 16> State;
+
+        private:
+            // The input words, including the nonce.
+            State input;
+
+            /**
+             * Rotates a word left.
+             */
+            static uint32_t rotate(uint32_t value, int count)
+            {
+                return (value << count) | (value >> (32 - count));
+            }
+
+            /**
+             * Makes the key stream block with the given counter.
+             */
+            void block(uint64_t counter, uint8_t *out) const
+            {
+                State x = input;
+
+                x[8] = static_cast<uint32_t>(counter);
+                x[9] = static_cast<uint32_t>(counter >> 32);
+
+                auto words = x;
+
+                for (auto i = 0; i < 10; ++i)
+                {
+                    // Columns.
+                    x[4] ^= rotate(x[0] + x[12], 7);
+                    x[8] ^= rotate(x[4] + x[0], 9);
+                    x[12] ^= rotate(x[8] + x[4], 13);
+                    x[0] ^= rotate(x[12] + x[8], 18);
+                    x[9] ^= rotate(x[5] + x[1], 7);
+                    x[13] ^= rotate(x[9] + x[5], 9);
+                    x[1] ^= rotate(x[13] + x[9], 13);
+                    x[5] ^= rotate(x[1] + x[13], 18);
+                    x[14] ^= rotate(x[10] + x[6], 7);
+                    x[2] ^= rotate(x[14] + x[10], 9);
+                    x[6] ^= rotate(x[2] + x[14], 13);
+                    x[10] ^= rotate(x[6] + x[2], 18);
+                    x[3] ^= rotate(x[15] + x[11], 7);
+                    x[7] ^= rotate(x[3] + x[15], 9);
+                    x[11] ^= rotate(x[7] + x[3], 13);
+                    x[15] ^= rotate(x[11] + x[7], 18);
+
+                    // Rows.
+                    x[1] ^= rotate(x[0] + x[3], 7);
+                    x[2] ^= rotate(x[1] + x[0], 9);
+                    x[3] ^= rotate(x[2] + x[1], 13);
+                    x[0] ^= rotate(x[3] + x[2], 18);
+                    x[6] ^= rotate(x[5] + x[4], 7);
+                    x[7] ^= rotate(x[6] + x[5], 9);
+                    x[4] ^= rotate(x[7] + x[6], 13);
+                    x[5] ^= rotate(x[4] + x[7], 18);
+                    x[11] ^= rotate(x[10] + x[9], 7);
+                    x[8] ^= rotate(x[11] + x[10], 9);
+                    x[9] ^= rotate(x[8] + x[11], 13);
+                    x[10] ^= rotate(x[9] + x[8], 18);
+                    x[12] ^= rotate(x[15] + x[14], 7);
+                    x[13] ^= rotate(x[12] + x[15], 9);
+                    x[14] ^= rotate(x[13] + x[12], 13);
+                    x[15] ^= rotate(x[14] + x[13], 18);
+                }
+
+                for (auto i = 0U; i < x.size(); ++i)
+                {
+                    auto word = x[i] + words[i];
+
+                    out[i * 4] = static_cast<uint8_t>(word);
+                    out[i * 4 + 1] = static_cast<uint8_t>(word >> 8);
+                    out[i * 4 + 2] = static_cast<uint8_t>(word >> 16);
+                    out[i * 4 + 3] = static_cast<uint8_t>(word >> 24);
+                }
+            }
+
+        public:
+            /**
+             * Sets up the input words for a 16 or 32 byte key. This is the part
+             * shared by every nonce, so it can be done once per key and kept.
+             */
+            static State expand(const uint8_t *key, size_t size)
+            {
+                if (size != 16 && size != 32)
+                {
+                    throw Exceptions::CascException("Salsa20 keys are 16 or 32 bytes long.");
+                }
+
+                // "expand 16-byte k" or "expand 32-byte k".
+                State state{};
+                state[0] = 0x61707865;
+                state[5] = size == 16 ? 0x3120646E : 0x3320646E;
+                state[10] = size == 16 ? 0x79622D36 : 0x79622D32;
+                state[15] = 0x6B206574;
+
+                auto second = size == 16 ? key : key + 16;
+
+                for (auto i = 0; i < 4; ++i)
+                {
+                    state[1 + i] = IO::Endian::read<IO::EndianType::Little, uint32_t>(key + i * 4);
+                    state[11 + i] = IO::Endian::read<IO::EndianType::Little, uint32_t>(second + i * 4);
+                }
+
+                return state;
+            }
+
+            /**
+             * Constructor. Takes the expanded key and an 8 byte nonce.
+             */
+            Salsa20(const State &key, const uint8_t *nonce)
+                : input(key)
+            {
+                input[6] = IO::Endian::read<IO::EndianType::Little, uint32_t>(nonce);
+                input[7] = IO::Endian::read<IO::EndianType::Little, uint32_t>(nonce + 4);
+            }
+
+            /**
+             * Encrypts or decrypts count bytes in place, which start at the
+             * given offset in the stream.
+             */
+            void apply(uint64_t offset, char *data, size_t count) const
+            {
+                uint8_t stream[BlockSize];
+
+                while (count > 0)
+                {
+                    auto skip = static_cast<size_t>(offset % BlockSize);
+                    auto n = count < BlockSize - skip ? count : BlockSize - skip;
+
+                    block(offset / BlockSize, stream);
+
+                    for (auto i = 0U; i < n; ++i)
+                    {
+                        data[i] ^= stream[skip + i];
+                    }
+
+                    data += n;
+                    offset += n;
+                    count -= n;
+                }
+            }
+        };
+    }
+}
\ No newline at end of file
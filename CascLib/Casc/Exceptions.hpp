@@ -6,6 +6,8 @@
 #include "Exceptions/FilesystemException.hpp"
 #include "Exceptions/IOException.hpp"
 
+#include "Exceptions/EncryptionKeyDoesNotExistException.hpp"
+#include "Exceptions/FileIdDoesNotExistException.hpp"
 #include "Exceptions/FileNotFoundException.hpp"
 #include "Exceptions/FilenameDoesNotExistException.hpp"
 #include "Exceptions/HashDoesNotExistException.hpp"
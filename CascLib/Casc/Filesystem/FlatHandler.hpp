@@ -0,0 +1,497 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <stdint.h>
+#include <vector>
+
+#include "../Common.hpp"
+#include "../Exceptions.hpp"
+#include "../Key.hpp"
+#include "Handler.hpp"
+#include "RootFilter.hpp"
+
+#include "../IO/MappedArray.hpp"
+#include "../IO/Snapshot.hpp"
+#include "../Crypto/Lookup3.hpp"
+
+namespace Casc
+{
+    namespace Filesystem
+    {
+        /**
+         * A root handler that keeps its records in one flat name table. Each root
+         * format parses into it with a Builder, and shares its lookups and snapshots.
+         */
+        class FlatHandler : public Handler
+        {
+        protected:
+            /**
+             * A root record, stored in place in the name table.
+             */
+            struct Entry
+            {
+                // The lookup3 hash of the filename, high word first.
+                uint64_t name;
+
+                // The content hash of the file. All zero in empty slots.
+                FileHash hash;
+
+                // The locales the file is for.
+                uint32_t locale;
+
+                // The content flags of the file.
+                uint32_t flags;
+            };
+
+            // Marks a record without a file data id, or an id that isn't listed.
+            static const uint32_t NoSlot = 0xFFFFFFFF;
+
+            /**
+             * The slot of the first record of a file data id.
+             */
+            struct IdSlot
+            {
+                // The file data id.
+                uint32_t id;
+
+                // The slot of its first record in the name table.
+                uint32_t slot;
+            };
+
+        private:
+            // The name table. Its size is a power of two and it is at most
+            // three quarters full. A record that collides takes the next free
+            // slot, so the variants of a name are found in root file order.
+            IO::MappedArray<Entry> entries;
+
+            // The slot of the first record of each file data id, or NoSlot.
+            // Used when the ids are dense enough to be indexed directly.
+            IO::MappedArray<uint32_t> ids;
+
+            // The slots of the file data ids sorted by id, used instead of ids
+            // when the ids are sparse, so a few large ids take little memory.
+            IO::MappedArray<IdSlot> sparseIds;
+
+            /**
+             * The slot a name is looked up at first.
+             */
+            static size_t slot(uint64_t name, size_t size)
+            {
+                return static_cast<size_t>(name ^ (name >> 32)) & (size - 1);
+            }
+
+            /**
+             * Checks if a slot is unused.
+             */
+            static bool empty(const Entry &entry)
+            {
+                return entry.hash == FileHash();
+            }
+
+            /**
+             * Stores a record after the earlier records with the same name. A record
+             * that only repeats an earlier one for other locales is merged into it.
+             * Returns the slot of the record, and counts the slots taken in used.
+             */
+            static size_t insert(std::vector<Entry> &table, const Entry &entry, size_t &used)
+            {
+                for (auto i = slot(entry.name, table.size());; i = (i + 1) & (table.size() - 1))
+                {
+                    if (empty(table[i]))
+                    {
+                        table[i] = entry;
+                        ++used;
+                        return i;
+                    }
+
+                    if (table[i].name == entry.name && table[i].hash == entry.hash && table[i].flags == entry.flags)
+                    {
+                        table[i].locale |= entry.locale;
+                        return i;
+                    }
+                }
+            }
+
+            /**
+             * Finds the first record for a name hash, or returns null.
+             */
+            const Entry *find(uint64_t name) const
+            {
+                if (entries.empty())
+                {
+                    return nullptr;
+                }
+
+                for (auto i = slot(name, entries.size());; i = (i + 1) & (entries.size() - 1))
+                {
+                    if (empty(entries[i]))
+                    {
+                        return nullptr;
+                    }
+
+                    if (entries[i].name == name)
+                    {
+                        return &entries[i];
+                    }
+                }
+            }
+
+        protected:
+            /**
+             * Collects the records of a root file in a name table that grows as needed.
+             */
+            class Builder
+            {
+                friend class FlatHandler;
+
+                // The name table being filled.
+                std::vector<Entry> table;
+
+                // The file data ids of the records and their slots, in root file order.
+                std::vector<IdSlot> slots;
+
+                // The number of slots in use.
+                size_t used = 0;
+
+                /**
+                 * Moves the records to a table twice the size. Every run of used slots
+                 * is walked from its start, so the records of a name stay in root file
+                 * order, and the file data ids are pointed at the new slots.
+                 */
+                void grow()
+                {
+                    std::vector<Entry> larger(table.size() * 2);
+                    std::vector<uint32_t> moved(table.size(), uint32_t(NoSlot));
+                    size_t count = 0;
+
+                    auto mask = table.size() - 1;
+                    auto start = size_t(std::find_if(table.begin(), table.end(), empty) - table.begin());
+
+                    for (auto k = 1U; k <= table.size(); ++k)
+                    {
+                        auto i = (start + k) & mask;
+
+                        if (!empty(table[i]))
+                        {
+                            moved[i] = static_cast<uint32_t>(insert(larger, table[i], count));
+                        }
+                    }
+
+                    for (auto &position : slots)
+                    {
+                        position.slot = moved[position.slot];
+                    }
+
+                    table.swap(larger);
+                }
+
+            public:
+                /**
+                 * Constructor. Sizes the table so the given number of records
+                 * fits without growing it.
+                 */
+                Builder(size_t records = 0)
+                {
+                    size_t capacity = 16U;
+
+                    while (capacity * 3 < records * 4)
+                    {
+                        capacity *= 2;
+                    }
+
+                    table.resize(capacity);
+                }
+
+                /**
+                 * Adds a record. Records with an all zero content hash name no file,
+                 * and are skipped.
+                 */
+                void add(uint64_t name, const FileHash &hash, uint32_t locale, uint32_t flags, uint32_t id = NoSlot)
+                {
+                    Entry entry;
+                    entry.name = name;
+                    entry.hash = hash;
+                    entry.locale = locale;
+                    entry.flags = flags;
+
+                    if (empty(entry))
+                    {
+                        return;
+                    }
+
+                    if ((used + 1) * 4 > table.size() * 3)
+                    {
+                        grow();
+                    }
+
+                    auto position = insert(table, entry, used);
+
+                    if (id == NoSlot)
+                    {
+                        return;
+                    }
+
+                    slots.push_back(IdSlot{ id, static_cast<uint32_t>(position) });
+                }
+            };
+
+            /**
+             * Combines the words returned by lookup3 into a name hash.
+             */
+            static uint64_t nameHash(const std::pair<uint32_t, uint32_t> &hash)
+            {
+                return (uint64_t(hash.first) << 32) | hash.second;
+            }
+
+            /**
+             * Hashes a filename read from a root file. The name is changed in place to
+             * upper case with backslashes, the form names are looked up in.
+             */
+            static uint64_t nameHash(std::string &name)
+            {
+                for (auto &c : name)
+                {
+                    c = c == '/' ? '\\' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+                }
+
+                return nameHash(Crypto::lookup3(name));
+            }
+
+            /**
+             * Takes over the tables of a builder. The file data ids are indexed
+             * directly if that takes no more memory than sorting them, so the id
+             * table never grows past twice the number of records.
+             */
+            void assign(Builder &builder)
+            {
+                entries = IO::MappedArray<Entry>(std::move(builder.table));
+
+                uint32_t last = 0;
+
+                for (auto &position : builder.slots)
+                {
+                    last = std::max(last, position.id);
+                }
+
+                if (builder.slots.empty())
+                {
+                    ids = IO::MappedArray<uint32_t>();
+                    sparseIds = IO::MappedArray<IdSlot>();
+                }
+                else if (last < builder.slots.size() * 2)
+                {
+                    std::vector<uint32_t> dense(size_t(last) + 1, uint32_t(NoSlot));
+
+                    for (auto &position : builder.slots)
+                    {
+                        if (dense[position.id] == NoSlot)
+                        {
+                            dense[position.id] = position.slot;
+                        }
+                    }
+
+                    ids = IO::MappedArray<uint32_t>(std::move(dense));
+                    sparseIds = IO::MappedArray<IdSlot>();
+                }
+                else
+                {
+                    auto &sorted = builder.slots;
+
+                    std::stable_sort(sorted.begin(), sorted.end(), [](const IdSlot &a, const IdSlot &b)
+                    {
+                        return a.id < b.id;
+                    });
+
+                    sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const IdSlot &a, const IdSlot &b)
+                    {
+                        return a.id == b.id;
+                    }), sorted.end());
+                    sorted.shrink_to_fit();
+
+                    ids = IO::MappedArray<uint32_t>();
+                    sparseIds = IO::MappedArray<IdSlot>(std::move(sorted));
+                }
+
+                builder.slots.clear();
+            }
+
+        public:
+            /**
+             * Find the file content hash for the given filename.
+             */
+            FileHash findHash(std::string path) const override
+            {
+                auto entry = find(nameHash(Crypto::lookup3(path)));
+
+                if (entry == nullptr)
+                {
+                    throw Exceptions::FilenameDoesNotExistException(path);
+                }
+
+                return entry->hash;
+            };
+
+            /**
+             * Find the file content hash for the given file data id.
+             */
+            FileHash findHashById(uint32_t id) const override
+            {
+                if (id < ids.size() && ids[id] != NoSlot)
+                {
+                    return entries[ids[id]].hash;
+                }
+
+                auto position = std::lower_bound(sparseIds.begin(), sparseIds.end(), id,
+                    [](const IdSlot &slot, uint32_t value)
+                {
+                    return slot.id < value;
+                });
+
+                if (position == sparseIds.end() || position->id != id)
+                {
+                    throw Exceptions::FileIdDoesNotExistException(id);
+                }
+
+                return entries[position->slot].hash;
+            }
+
+            /**
+             * Find every file the given filename refers to, in root file order.
+             */
+            std::vector<FileVariant> findAll(std::string path) const override
+            {
+                std::vector<FileVariant> variants;
+
+                auto name = nameHash(Crypto::lookup3(path));
+
+                for (auto i = slot(name, entries.size()); !entries.empty() && !empty(entries[i]);
+                    i = (i + 1) & (entries.size() - 1))
+                {
+                    if (entries[i].name == name)
+                    {
+                        variants.push_back(FileVariant{ entries[i].hash, entries[i].locale, entries[i].flags });
+                    }
+                }
+
+                if (variants.empty())
+                {
+                    throw Exceptions::FilenameDoesNotExistException(path);
+                }
+
+                return variants;
+            }
+
+            /**
+             * Find the file content hashes for several filenames, in order.
+             * Returns the indices of the filenames that don't exist.
+             */
+            std::vector<size_t> findHashes(const std::vector<std::string> &paths,
+                std::vector<FileHash> &hashes) const override
+            {
+                std::vector<std::pair<const char*, size_t>> buffers;
+                buffers.reserve(paths.size());
+
+                for (auto &path : paths)
+                {
+                    buffers.emplace_back(path.data(), path.size());
+                }
+
+                auto names = Crypto::lookup3Many(buffers);
+
+                std::vector<size_t> missing;
+                hashes.assign(paths.size(), FileHash());
+
+                for (auto i = 0U; i < paths.size(); ++i)
+                {
+                    auto entry = find(nameHash(names[i]));
+
+                    if (entry == nullptr)
+                    {
+                        missing.push_back(i);
+                    }
+                    else
+                    {
+                        hashes[i] = entry->hash;
+                    }
+                }
+
+                return missing;
+            }
+
+            /**
+             * Writes the name table to a snapshot.
+             */
+            void save(IO::SnapshotWriter &writer) const override
+            {
+                writer.write(entries.data(), entries.size());
+                writer.write(ids.data(), ids.size());
+                writer.write(sparseIds.data(), sparseIds.size());
+            }
+
+            /**
+             * Default constructor. The table is filled in by assign.
+             */
+            FlatHandler()
+            {
+
+            }
+
+            /**
+             * Constructor. Loads a name table written to a snapshot by save.
+             */
+            FlatHandler(IO::SnapshotReader &reader)
+                : entries(reader.readArray<Entry>()), ids(reader.readArray<uint32_t>()),
+                  sparseIds(reader.readArray<IdSlot>())
+            {
+                auto invalid = std::find_if(ids.begin(), ids.end(), [this](uint32_t position)
+                {
+                    return position != NoSlot && position >= entries.size();
+                });
+
+                auto invalidSparse = std::find_if(sparseIds.begin(), sparseIds.end(), [this](const IdSlot &position)
+                {
+                    return position.slot >= entries.size();
+                });
+
+                auto unsorted = std::adjacent_find(sparseIds.begin(), sparseIds.end(), [](const IdSlot &a, const IdSlot &b)
+                {
+                    return a.id >= b.id;
+                });
+
+                // Lookups stop at an empty slot, so a table fuller than a builder
+                // leaves it would make them loop.
+                auto used = size_t(std::count_if(entries.begin(), entries.end(), [](const Entry &entry)
+                {
+                    return !empty(entry);
+                }));
+
+                if (entries.empty() || (entries.size() & (entries.size() - 1)) != 0 || used * 4 > entries.size() * 3 ||
+                    invalid != ids.end() || invalidSparse != sparseIds.end() || unsorted != sparseIds.end())
+                {
+                    throw Exceptions::ParserException("The snapshot has an invalid name table.");
+                }
+            }
+        };
+    }
+}
\ No newline at end of file
@@ -25,18 +25,29 @@
 #include <stdint.h>
 #include <array>
 #include <fstream>
+#include <functional>
+#include <istream>
+#include <vector>
 
 #include "../Common.hpp"
-#include "../Hex.hpp"
+#include "../Exceptions.hpp"
+#include "../Key.hpp"
+#include "../IO/Snapshot.hpp"
+#include "RootFilter.hpp"
 
 namespace Casc
 {
     namespace Filesystem
     {
         /**
-         * Maps filename to file content MD5 hash.
-         *
-         * TODO: Finish implementation, need different handling per game.
+         * Opens a file in the container by its content hash, for root formats that are
+         * split over several files. Sets size to the decoded size of the file.
+         */
+        typedef std::function<std::shared_ptr<std::istream>(const FileHash &hash, size_t &size)> FileOpener;
+
+        /**
+         * Maps filename to file content MD5 hash. Each root format has its
+         * own handler, created through HandlerRegistry.
          */
         class Handler
         {
@@ -44,7 +55,59 @@ namespace Casc
             /**
              * Find the file content hash for the given filename.
              */
-            virtual Hex findHash(std::string path) const = 0;
+            virtual FileHash findHash(std::string path) const = 0;
+
+            /**
+             * Find the file content hash for the given file data id.
+             */
+            virtual FileHash findHashById(uint32_t) const
+            {
+                throw Exceptions::FilesystemException("This root file format doesn't list file data ids.");
+            }
+
+            /**
+             * Find every file the given filename refers to, one per set of
+             * locales and content flags, in the order they are listed in the root.
+             */
+            virtual std::vector<FileVariant> findAll(std::string path) const
+            {
+                return{ FileVariant{ findHash(path), Locale::All, 0 } };
+            }
+
+            /**
+             * Find the file content hashes for several filenames, in order.
+             * Returns the indices of the filenames that don't exist; their
+             * hashes are left empty.
+             */
+            virtual std::vector<size_t> findHashes(const std::vector<std::string> &paths,
+                std::vector<FileHash> &hashes) const
+            {
+                std::vector<size_t> missing;
+
+                hashes.assign(paths.size(), FileHash());
+
+                for (auto i = 0U; i < paths.size(); ++i)
+                {
+                    try
+                    {
+                        hashes[i] = findHash(paths[i]);
+                    }
+                    catch (Exceptions::FilenameDoesNotExistException &)
+                    {
+                        missing.push_back(i);
+                    }
+                }
+
+                return missing;
+            }
+
+            /**
+             * Writes the parsed root to a snapshot.
+             */
+            virtual void save(IO::SnapshotWriter &) const
+            {
+                throw Exceptions::FilesystemException("This root file format can't be saved to a snapshot.");
+            }
 
         protected:
             /**
@@ -97,4 +160,6 @@ namespace Casc
     }
 }
 
-#include "Impl/WoWHandler.hpp"
\ No newline at end of file
+#include "Impl/WoWHandler.hpp"
+#include "Impl/D3Handler.hpp"
+#include "Impl/OverwatchHandler.hpp"
\ No newline at end of file
@@ -0,0 +1,189 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "../Common.hpp"
+#include "../Exceptions.hpp"
+#include "../ProgramCodes.hpp"
+#include "Handler.hpp"
+#include "RootFilter.hpp"
+#include "../IO/Snapshot.hpp"
+
+namespace Casc
+{
+    namespace Filesystem
+    {
+        /**
+         * Creates the root handler for a program. The built in handlers are
+         * registered up front; others can be added, or replace them, with add.
+         *
+         * Built in are the WoW, Diablo III and text Overwatch roots. The MNDX
+         * roots of Heroes of the Storm and StarCraft II, and the TVFS roots of
+         * newer Overwatch builds, are a separate piece of work. Until then they
+         * are reported by their signature. Callers that need them can register
+         * their own handler with add.
+         */
+        class HandlerRegistry
+        {
+        public:
+            /**
+             * Parses a root file of the given size from a stream.
+             */
+            typedef std::function<std::unique_ptr<Handler>(std::istream &stream, size_t size,
+                const RootFilter &filter, const FileOpener &open)> Parser;
+
+            /**
+             * Loads a root written to a snapshot by Handler::save.
+             */
+            typedef std::function<std::unique_ptr<Handler>(IO::SnapshotReader &reader)> Loader;
+
+        private:
+            /**
+             * The ways to create the root handler of a program.
+             */
+            struct Factory
+            {
+                Parser parse;
+                Loader load;
+            };
+
+            /**
+             * Creates a handler for a root format that is split over several files.
+             */
+            template <typename T>
+            static std::unique_ptr<Handler> create(std::istream &stream, size_t size,
+                const RootFilter &filter, const FileOpener &open, std::true_type)
+            {
+                return std::make_unique<T>(stream, size, filter, open);
+            }
+
+            /**
+             * Creates a handler for a root format that is a single file.
+             */
+            template <typename T>
+            static std::unique_ptr<Handler> create(std::istream &stream, size_t size,
+                const RootFilter &filter, const FileOpener &, std::false_type)
+            {
+                return std::make_unique<T>(stream, size, filter);
+            }
+
+            /**
+             * Makes a factory for a handler with the stream and snapshot constructors.
+             */
+            template <typename T>
+            static Factory factory()
+            {
+                typedef std::is_constructible<T, std::istream&, size_t, const RootFilter&, const FileOpener&> opens;
+
+                return Factory
+                {
+                    [](std::istream &stream, size_t size, const RootFilter &filter, const FileOpener &open)
+                    {
+                        return create<T>(stream, size, filter, open, opens());
+                    },
+                    [](IO::SnapshotReader &reader)
+                    {
+                        return std::unique_ptr<Handler>(std::make_unique<T>(reader));
+                    }
+                };
+            }
+
+            /**
+             * The registered factories, by program.
+             */
+            static std::map<ProgramCode, Factory> &factories()
+            {
+                static std::map<ProgramCode, Factory> factories =
+                {
+                    { ProgramCode::wow, factory<Impl::WoWHandler>() },
+                    { ProgramCode::wowt, factory<Impl::WoWHandler>() },
+                    { ProgramCode::wow_beta, factory<Impl::WoWHandler>() },
+                    { ProgramCode::d3, factory<Impl::D3Handler>() },
+                    { ProgramCode::d3t, factory<Impl::D3Handler>() },
+                    { ProgramCode::d3b, factory<Impl::D3Handler>() },
+                    { ProgramCode::pro, factory<Impl::OverwatchHandler>() },
+                    { ProgramCode::prot, factory<Impl::OverwatchHandler>() }
+                };
+
+                return factories;
+            }
+
+            /**
+             * Finds the factory for a program.
+             */
+            static const Factory &find(ProgramCode program)
+            {
+                auto it = factories().find(program);
+
+                if (it == factories().end())
+                {
+                    throw Exceptions::FilesystemException("Unsupported root file format");
+                }
+
+                return it->second;
+            }
+
+        public:
+            /**
+             * Registers the handler for a program. Not thread safe; handlers
+             * should be registered before any container is opened.
+             */
+            static void add(ProgramCode program, Parser parse, Loader load)
+            {
+                factories()[program] = Factory{ parse, load };
+            }
+
+            /**
+             * Parses the root file of a program.
+             */
+            static std::unique_ptr<Handler> parse(ProgramCode program, std::istream &stream, size_t size,
+                const RootFilter &filter, const FileOpener &open)
+            {
+                if (factories().count(program) == 0)
+                {
+                    std::string signature(4, '\0');
+                    stream.read(&signature[0], signature.size());
+
+                    if (signature == "MNDX" || signature == "TVFS")
+                    {
+                        throw Exceptions::FilesystemException("Unsupported root file format " + signature);
+                    }
+                }
+
+                return find(program).parse(stream, size, filter, open);
+            }
+
+            /**
+             * Loads the root of a program from a snapshot.
+             */
+            static std::unique_ptr<Handler> load(ProgramCode program, IO::SnapshotReader &reader)
+            {
+                return find(program).load(reader);
+            }
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <istream>
+#include <string>
+#include <stdint.h>
+#include <vector>
+
+#include "../../Common.hpp"
+#include "../../Exceptions.hpp"
+#include "../../Key.hpp"
+#include "../FlatHandler.hpp"
+
+#include "../../IO/Endian.hpp"
+#include "../../IO/Snapshot.hpp"
+
+namespace Casc
+{
+    namespace Filesystem
+    {
+        namespace Impl
+        {
+            /**
+             * Maps filename to file content MD5 hash for Diablo III. The root lists
+             * directories, such as Base or enUS_Text, each stored in its own file.
+             *
+             * Assets are listed by SNO id only. They are named Dir\Id, or Dir\Id\Index
+             * for the parts of an asset, and can be looked up by SNO id as well.
+             * The game's own asset paths, such as Base\Actor\Barbarian.acr, come
+             * from CoreTOC.dat, which isn't read, so they don't resolve by name.
+             * Only the files a directory lists by name, such as Base\CoreTOC.dat,
+             * can be looked up by their real path.
+             */
+            class D3Handler : public FlatHandler
+            {
+                // The signature of the root file.
+                static const uint32_t RootSignature = 0x8007D0C4;
+
+                // The signature of a directory file.
+                static const uint32_t DirectorySignature = 0xEAF1FE87;
+
+                /**
+                 * Reads a little endian integer from a stream.
+                 */
+                static uint32_t readUInt32(std::istream &stream)
+                {
+                    char b[4];
+
+                    if (!stream.read(b, sizeof(b)))
+                    {
+                        throw Exceptions::ParserException("Unexpected end of root file.");
+                    }
+
+                    return IO::Endian::read<IO::EndianType::Little, uint32_t>(b);
+                }
+
+                /**
+                 * Reads a content hash from a stream.
+                 */
+                static FileHash readHash(std::istream &stream)
+                {
+                    char b[16];
+
+                    if (!stream.read(b, sizeof(b)))
+                    {
+                        throw Exceptions::ParserException("Unexpected end of root file.");
+                    }
+
+                    return FileHash(b, b + sizeof(b));
+                }
+
+                /**
+                 * Reads a null terminated name from a stream and appends it to a string.
+                 */
+                static void readName(std::istream &stream, std::string &name)
+                {
+                    for (auto c = stream.get(); c != 0; c = stream.get())
+                    {
+                        if (c == std::char_traits<char>::eof())
+                        {
+                            throw Exceptions::ParserException("Unexpected end of root file.");
+                        }
+
+                        name.push_back(static_cast<char>(c));
+                    }
+                }
+
+                /**
+                 * The locale a directory is for. Directories that don't start
+                 * with a locale name, such as Base, are for all locales.
+                 */
+                static uint32_t localeOf(const std::string &directory)
+                {
+                    static const std::pair<const char*, uint32_t> locales[] =
+                    {
+                        { "enUS", Locale::enUS }, { "koKR", Locale::koKR }, { "frFR", Locale::frFR },
+                        { "deDE", Locale::deDE }, { "zhCN", Locale::zhCN }, { "esES", Locale::esES },
+                        { "zhTW", Locale::zhTW }, { "enGB", Locale::enGB }, { "enCN", Locale::enCN },
+                        { "enTW", Locale::enTW }, { "esMX", Locale::esMX }, { "ruRU", Locale::ruRU },
+                        { "ptBR", Locale::ptBR }, { "itIT", Locale::itIT }, { "ptPT", Locale::ptPT }
+                    };
+
+                    for (auto &entry : locales)
+                    {
+                        if (directory.compare(0, 4, entry.first) == 0)
+                        {
+                            return entry.second;
+                        }
+                    }
+
+                    return Locale::All;
+                }
+
+                /**
+                 * Appends a backslash and a number to a name.
+                 */
+                static void appendId(std::string &name, uint32_t id)
+                {
+                    char digits[10];
+                    auto count = 0U;
+
+                    do
+                    {
+                        digits[count++] = '0' + id % 10;
+                        id /= 10;
+                    } while (id != 0);
+
+                    name.push_back('\\');
+
+                    while (count > 0)
+                    {
+                        name.push_back(digits[--count]);
+                    }
+                }
+
+                /**
+                 * Adds the files listed in a directory file.
+                 */
+                static void loadDirectory(Builder &builder, std::istream &stream,
+                    const std::string &directory, uint32_t locale, std::string &name)
+                {
+                    auto signature = readUInt32(stream);
+
+                    if (signature != DirectorySignature)
+                    {
+                        throw Exceptions::InvalidSignatureException(signature, DirectorySignature);
+                    }
+
+                    // Whole assets, listed by SNO id.
+                    for (auto i = 0U, count = readUInt32(stream); i < count; ++i)
+                    {
+                        auto hash = readHash(stream);
+                        auto id = readUInt32(stream);
+
+                        name.assign(directory);
+                        appendId(name, id);
+
+                        builder.add(nameHash(name), hash, locale, 0, id);
+                    }
+
+                    // The parts of assets, listed by SNO id and part index.
+                    for (auto i = 0U, count = readUInt32(stream); i < count; ++i)
+                    {
+                        auto hash = readHash(stream);
+                        auto id = readUInt32(stream);
+                        auto index = readUInt32(stream);
+
+                        name.assign(directory);
+                        appendId(name, id);
+                        appendId(name, index);
+
+                        builder.add(nameHash(name), hash, locale, 0);
+                    }
+
+                    // Files listed by name.
+                    for (auto i = 0U, count = readUInt32(stream); i < count; ++i)
+                    {
+                        auto hash = readHash(stream);
+
+                        name.assign(directory);
+                        name.push_back('\\');
+                        readName(stream, name);
+
+                        builder.add(nameHash(name), hash, locale, 0);
+                    }
+                }
+
+            public:
+                /**
+                 * Constructor. Reads the root from a stream, and each directory the
+                 * filter accepts from the file open returns for its content hash.
+                 */
+                D3Handler(std::istream &stream, size_t size, const RootFilter &filter, const FileOpener &open)
+                {
+                    auto signature = readUInt32(stream);
+
+                    if (signature != RootSignature)
+                    {
+                        throw Exceptions::InvalidSignatureException(signature, RootSignature);
+                    }
+
+                    auto count = readUInt32(stream);
+
+                    // Each directory takes at least a hash and a terminator.
+                    if (size_t(count) * 17 > size)
+                    {
+                        throw Exceptions::ParserException("The root file lists more directories than it holds.");
+                    }
+
+                    std::vector<std::pair<FileHash, std::string>> directories(count);
+
+                    for (auto &directory : directories)
+                    {
+                        directory.first = readHash(stream);
+                        readName(stream, directory.second);
+                    }
+
+                    Builder builder;
+                    std::string name;
+
+                    for (auto &directory : directories)
+                    {
+                        auto locale = localeOf(directory.second);
+
+                        if (!filter.accepts(locale, 0))
+                        {
+                            continue;
+                        }
+
+                        size_t directorySize;
+                        auto directoryStream = open(directory.first, directorySize);
+
+                        loadDirectory(builder, *directoryStream, directory.second, locale, name);
+                    }
+
+                    assign(builder);
+                }
+
+                /**
+                 * Constructor. Loads a name table written to a snapshot by save.
+                 */
+                D3Handler(IO::SnapshotReader &reader)
+                    : FlatHandler(reader)
+                {
+                }
+            };
+        }
+    }
+}
\ No newline at end of file
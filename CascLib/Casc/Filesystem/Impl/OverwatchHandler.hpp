@@ -0,0 +1,175 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <istream>
+#include <string>
+#include <stdint.h>
+
+#include "../../Common.hpp"
+#include "../../Exceptions.hpp"
+#include "../../Key.hpp"
+#include "../FlatHandler.hpp"
+
+#include "../../IO/Snapshot.hpp"
+
+namespace Casc
+{
+    namespace Filesystem
+    {
+        namespace Impl
+        {
+            /**
+             * Maps filename to file content MD5 hash for Overwatch. The root is a text
+             * table with one file per line, fields split by '|', and a header line
+             * starting with '#' that names the columns.
+             */
+            class OverwatchHandler : public FlatHandler
+            {
+                /**
+                 * Finds the bounds of a field in a line. Returns false if the line
+                 * has fewer fields.
+                 */
+                static bool field(const std::string &line, size_t index, size_t &first, size_t &last)
+                {
+                    first = 0;
+
+                    for (auto i = 0U; i < index; ++i)
+                    {
+                        first = line.find('|', first);
+
+                        if (first == std::string::npos)
+                        {
+                            return false;
+                        }
+
+                        ++first;
+                    }
+
+                    last = std::min(line.find('|', first), line.size());
+
+                    return true;
+                }
+
+                /**
+                 * Finds the index of a named column in the header line.
+                 */
+                static size_t column(const std::string &header, const std::string &name)
+                {
+                    size_t first, last;
+
+                    for (auto i = 0U; field(header, i, first, last); ++i)
+                    {
+                        if (header.compare(first, last - first, name) == 0)
+                        {
+                            return i;
+                        }
+                    }
+
+                    throw Exceptions::ParserException("The root file has no " + name + " column.");
+                }
+
+            public:
+                /**
+                 * Constructor. Reads the root from a stream a line at a time. The root
+                 * lists no locales or content flags, so the filter doesn't apply.
+                 */
+                OverwatchHandler(std::istream &stream, size_t size, const RootFilter & = RootFilter())
+                {
+                    std::string line;
+
+                    if (!std::getline(stream, line))
+                    {
+                        throw Exceptions::ParserException("The root file has no column header.");
+                    }
+
+                    // Newer builds list their files in a TVFS root, which has no handler yet.
+                    if (line.compare(0, 4, "TVFS") == 0)
+                    {
+                        throw Exceptions::FilesystemException("Unsupported root file format TVFS");
+                    }
+
+                    if (line.empty() || line[0] != '#')
+                    {
+                        throw Exceptions::ParserException("The root file has no column header.");
+                    }
+
+                    if (line.back() == '\r')
+                    {
+                        line.pop_back();
+                    }
+
+                    line.erase(0, 1);
+
+                    auto hashColumn = column(line, "MD5");
+                    auto nameColumn = column(line, "FILENAME");
+
+                    // A line holds at least a hex hash, a separator and a newline.
+                    Builder builder(size / 34);
+
+                    std::string hash;
+                    std::string name;
+
+                    while (std::getline(stream, line))
+                    {
+                        if (!line.empty() && line.back() == '\r')
+                        {
+                            line.pop_back();
+                        }
+
+                        if (line.empty() || line[0] == '#')
+                        {
+                            continue;
+                        }
+
+                        size_t first, last;
+
+                        if (!field(line, hashColumn, first, last))
+                        {
+                            throw Exceptions::ParserException("A root file line has no MD5 field.");
+                        }
+
+                        hash.assign(line, first, last - first);
+
+                        if (!field(line, nameColumn, first, last))
+                        {
+                            throw Exceptions::ParserException("A root file line has no FILENAME field.");
+                        }
+
+                        name.assign(line, first, last - first);
+
+                        builder.add(nameHash(name), FileHash(hash), Locale::All, 0);
+                    }
+
+                    assign(builder);
+                }
+
+                /**
+                 * Constructor. Loads a name table written to a snapshot by save.
+                 */
+                OverwatchHandler(IO::SnapshotReader &reader)
+                    : FlatHandler(reader)
+                {
+                }
+            };
+        }
+    }
+}
\ No newline at end of file
@@ -19,19 +19,23 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <memory>
-#include <map>
 #include <stdint.h>
 #include <array>
+#include <cstring>
 #include <fstream>
+#include <istream>
+#include <vector>
 
 #include "../../Common.hpp"
-#include "../../Hex.hpp"
-#include "../Handler.hpp"
+#include "../../Exceptions.hpp"
+#include "../../Key.hpp"
+#include "../FlatHandler.hpp"
 
 #include "../../IO/Endian.hpp"
-#include "../../Crypto/Lookup3.hpp"
+#include "../../IO/Snapshot.hpp"
 
 namespace Casc
 {
@@ -42,62 +46,125 @@ namespace Casc
             /**
              * Maps filename to file content MD5 hash. Uses lookup3.
              */
-            class WoWHandler : public Handler
+            class WoWHandler : public FlatHandler
             {
-                std::map<std::pair<uint32_t, uint32_t>, uint32_t> integers;
-                std::map<std::pair<uint32_t, uint32_t>, Hex> checksums;
+                // The number of root records read at a time.
+                static const uint32_t RecordsPerBatch = 4096;
 
-            public:
                 /**
-                 * Find the file content hash for the given filename.
+                 * Builds the tables from a root file of the given size. read(out, count)
+                 * reads the next bytes of the file, and returns false at the end of it.
                  */
-                Hex findHash(std::string path) const override
+                template <typename Read>
+                void load(Read read, size_t size, const RootFilter &filter)
                 {
-                    return checksums.at(Crypto::lookup3(path));
-                };
+                    // A record takes at least 28 bytes. When every block is kept
+                    // that bounds the table, which then never has to grow.
+                    auto keepsAll = filter.locales == Locale::All && filter.requiredFlags == 0 && filter.excludedFlags == 0;
 
-            public:
-                /**
-                 * Default constructor.
-                 */
-                WoWHandler(std::vector<char> &data)
-                {
-                    for (auto it = data.begin(), end = data.end(); it < end;)
-                    {
-                        auto count = IO::Endian::read<IO::EndianType::Little, uint32_t, true>(it);
-                        auto flags = IO::Endian::read<IO::EndianType::Little, uint32_t, true>(it);
-                        auto locale = IO::Endian::read<IO::EndianType::Little, uint32_t, true>(it);
+                    Builder builder(keepsAll ? size / 28 : 0);
+
+                    std::vector<char> buffer(24 * RecordsPerBatch);
+                    std::vector<uint32_t> blockIds;
+                    char header[12];
 
-                        std::vector<std::pair<uint32_t, uint32_t>> hashes;
-                        std::vector<uint32_t> integers;
-                        std::vector<Hex> checksums;
+                    while (read(header, sizeof(header)))
+                    {
+                        auto count = IO::Endian::read<IO::EndianType::Little, uint32_t>(header);
+                        auto flags = IO::Endian::read<IO::EndianType::Little, uint32_t>(header + 4);
+                        auto locale = IO::Endian::read<IO::EndianType::Little, uint32_t>(header + 8);
+                        auto keep = filter.accepts(locale, flags);
 
-                        std::map<uint32_t, uint32_t> counts;
+                        // The file data ids come first. Each is stored as the
+                        // difference to one past the id before it.
+                        blockIds.resize(keep ? count : 0);
 
-                        for (auto i = 0U; i < count; ++i)
+                        for (uint32_t first = 0U, next = 0U; first < count; first += RecordsPerBatch)
                         {
-                            integers.push_back(IO::Endian::read<IO::EndianType::Little, uint32_t, true>(it));
+                            auto batch = std::min(count - first, uint32_t(RecordsPerBatch));
+
+                            if (!read(buffer.data(), 4 * batch))
+                            {
+                                throw Exceptions::ParserException("Unexpected end of root file.");
+                            }
+
+                            for (auto i = 0U; keep && i < batch; ++i)
+                            {
+                                blockIds[first + i] = next + IO::Endian::read<IO::EndianType::Little, uint32_t>(buffer.data() + 4 * i);
+                                next = blockIds[first + i] + 1;
+                            }
                         }
 
-                        for (auto i = 0U; i < count; ++i)
+                        for (uint32_t first = 0U; first < count; first += RecordsPerBatch)
                         {
-                            checksums.emplace_back(it, it + 16);
-                            it += 16;
+                            auto batch = std::min(count - first, uint32_t(RecordsPerBatch));
+
+                            if (!read(buffer.data(), 24 * batch))
+                            {
+                                throw Exceptions::ParserException("Unexpected end of root file.");
+                            }
+
+                            for (auto i = 0U; keep && i < batch; ++i)
+                            {
+                                auto it = buffer.data() + 24 * i;
 
-                            hashes.push_back(std::make_pair(
-                                IO::Endian::read<IO::EndianType::Little, uint32_t, true>(it),
-                                IO::Endian::read<IO::EndianType::Little, uint32_t, true>(it)));
+                                // The name hash is stored low word first, while
+                                // lookup3 returns the high word first.
+                                auto low = IO::Endian::read<IO::EndianType::Little, uint32_t>(it + 16);
+                                auto high = IO::Endian::read<IO::EndianType::Little, uint32_t>(it + 20);
+
+                                builder.add(nameHash(std::make_pair(high, low)), FileHash(it, it + 16),
+                                    locale, flags, blockIds[first + i]);
+                            }
                         }
+                    }
+
+                    assign(builder);
+                }
+
+            public:
+                /**
+                 * Default constructor. Only the blocks the filter accepts are loaded.
+                 */
+                WoWHandler(std::vector<char> &data, const RootFilter &filter = RootFilter())
+                {
+                    size_t offset = 0;
 
-                        for (auto i = 0U; i < count; i++)
+                    load([&data, &offset](char *out, size_t count)
+                    {
+                        if (count > data.size() - offset)
                         {
-                            this->integers[hashes[i]] = integers[i];
-                            this->checksums[hashes[i]] = checksums[i];
+                            return false;
                         }
-                    }
+
+                        std::memcpy(out, data.data() + offset, count);
+                        offset += count;
+
+                        return true;
+                    }, data.size(), filter);
+                }
+
+                /**
+                 * Constructor. Reads a root file of the given size from a stream,
+                 * a batch of records at a time, without buffering the whole file.
+                 */
+                WoWHandler(std::istream &stream, size_t size, const RootFilter &filter = RootFilter())
+                {
+                    load([&stream](char *out, size_t count)
+                    {
+                        stream.read(out, count);
+
+                        return size_t(stream.gcount()) == count;
+                    }, size, filter);
                 }
 
-                using Handler::Handler;
+                /**
+                 * Constructor. Loads a name table written to a snapshot by save.
+                 */
+                WoWHandler(IO::SnapshotReader &reader)
+                    : FlatHandler(reader)
+                {
+                }
             };
         }
     }
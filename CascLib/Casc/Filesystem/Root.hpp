@@ -21,10 +21,13 @@
 
 #include "../Common.hpp"
 #include "Handler.hpp"
+#include "HandlerRegistry.hpp"
+#include "RootFilter.hpp"
 #include "../Parsers/Binary/Encoding.hpp"
 #include "../Parsers/Binary/Index.hpp"
 #include "../IO/StreamAllocator.hpp"
 #include "../IO/Endian.hpp"
+#include "../IO/Snapshot.hpp"
 
 namespace Casc
 {
@@ -35,36 +38,64 @@ namespace Casc
             std::unique_ptr<Handler> handler = nullptr;
 
         public:
-            Root(ProgramCode game, Hex hash, std::shared_ptr<Parsers::Binary::Encoding> encoding = nullptr,
+            Root(ProgramCode game, const FileHash &hash, std::shared_ptr<Parsers::Binary::Encoding> encoding = nullptr,
                  std::shared_ptr<Parsers::Binary::Index> index = nullptr,
-                 std::shared_ptr<IO::StreamAllocator> allocator = nullptr)
+                 std::shared_ptr<IO::StreamAllocator> allocator = nullptr,
+                 const RootFilter &filter = RootFilter())
             {
                 auto fi = encoding->findFileInfo(hash);
                 auto enc = encoding->findEncodedFileInfo(fi.keys[0]);
-                auto ref = index->find(fi.keys[0].begin(), fi.keys[0].begin() + 9);
+                auto ref = index->find(IndexKey(fi.keys[0]));
                 
                 auto stream = allocator->data(ref);
 
-                std::vector<char> buf(fi.size);
-                stream->read(buf.data(), buf.size());
-
-                switch (game)
+                // Opens the other files of roots that are split over several.
+                auto open = [encoding, index, allocator](const FileHash &hash, size_t &size)
                 {
-                case ProgramCode::wow:
-                case ProgramCode::wowt:
-                case ProgramCode::wow_beta:
-                    handler = std::make_unique<Impl::WoWHandler>(buf);
-                    break;
+                    auto fi = encoding->findFileInfo(hash);
+                    size = fi.size;
+
+                    return std::shared_ptr<std::istream>(allocator->data(index->find(IndexKey(fi.keys[0]))));
+                };
 
-                default:
-                    throw Exceptions::FilesystemException("Unsupported root file format");
-                }
+                handler = HandlerRegistry::parse(game, *stream, fi.size, filter, open);
+            }
+
+            /**
+             * Constructor. Loads a root written to a snapshot by save.
+             */
+            Root(ProgramCode game, IO::SnapshotReader &reader)
+                : handler(HandlerRegistry::load(game, reader))
+            {
             }
 
-            Hex find(std::string path) const
+            /**
+             * Writes the parsed root to a snapshot.
+             */
+            void save(IO::SnapshotWriter &writer) const
+            {
+                handler->save(writer);
+            }
+
+            FileHash find(std::string path) const
             {
                 return handler->findHash(path);
             }
+
+            FileHash findById(uint32_t id) const
+            {
+                return handler->findHashById(id);
+            }
+
+            std::vector<FileVariant> findAll(std::string path) const
+            {
+                return handler->findAll(path);
+            }
+
+            std::vector<size_t> find(const std::vector<std::string> &paths, std::vector<FileHash> &hashes) const
+            {
+                return handler->findHashes(paths, hashes);
+            }
         };
     }
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "../Key.hpp"
+
+namespace Casc
+{
+    namespace Filesystem
+    {
+        /**
+         * The locale bits of a root block.
+         */
+        namespace Locale
+        {
+            enum : uint32_t
+            {
+                enUS = 0x2,
+                koKR = 0x4,
+                frFR = 0x10,
+                deDE = 0x20,
+                zhCN = 0x40,
+                esES = 0x80,
+                zhTW = 0x100,
+                enGB = 0x200,
+                enCN = 0x400,
+                enTW = 0x800,
+                esMX = 0x1000,
+                ruRU = 0x2000,
+                ptBR = 0x4000,
+                itIT = 0x8000,
+                ptPT = 0x10000,
+                All = 0xFFFFFFFF
+            };
+        }
+
+        /**
+         * The content flag bits of a root block.
+         */
+        namespace ContentFlags
+        {
+            enum : uint32_t
+            {
+                LoadOnWindows = 0x8,
+                LoadOnMacOS = 0x10,
+                LowViolence = 0x80,
+                DoNotLoad = 0x100,
+                UpdatePlugin = 0x800,
+                Encrypted = 0x8000000,
+                NoNameHash = 0x10000000,
+                UncommonResolution = 0x20000000,
+                Bundle = 0x40000000,
+                NoCompression = 0x80000000
+            };
+        }
+
+        /**
+         * Selects the root blocks that are kept when a root file is loaded.
+         */
+        struct RootFilter
+        {
+            // The locales to keep. A block is kept if it is for any of them.
+            uint32_t locales = Locale::All;
+
+            // A block is kept only if it has all of these content flags.
+            uint32_t requiredFlags = 0;
+
+            // A block is dropped if it has any of these content flags.
+            uint32_t excludedFlags = 0;
+
+            /**
+             * Checks if a block with the given locale and content flags is kept.
+             */
+            bool accepts(uint32_t locale, uint32_t flags) const
+            {
+                return (locale & locales) != 0 &&
+                    (flags & requiredFlags) == requiredFlags &&
+                    (flags & excludedFlags) == 0;
+            }
+        };
+
+        /**
+         * One of the files a filename refers to, for some locales and content flags.
+         */
+        struct FileVariant
+        {
+            // The content hash of the file.
+            FileHash hash;
+
+            // The locales the file is for.
+            uint32_t locale;
+
+            // The content flags of the file.
+            uint32_t flags;
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../Key.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        /**
+         * A size bounded cache of decoded chunks, shared by all the streams of a container.
+         * Entries are keyed by the file key and the index of the chunk in the file,
+         * and the least recently used entries are dropped when the budget is exceeded.
+         */
+        class BlockCache
+        {
+        public:
+            typedef std::shared_ptr<const std::vector<char>> block_type;
+
+            /**
+             * Cache counters.
+             */
+            struct Statistics
+            {
+                // The number of lookups that found a chunk.
+                size_t hits;
+
+                // The number of lookups that didn't.
+                size_t misses;
+
+                // The decoded bytes currently held.
+                size_t bytes;
+
+                // The number of chunks currently held.
+                size_t entries;
+            };
+
+        private:
+            typedef std::pair<IndexKey, size_t> key_type;
+
+            /**
+             * Hashes a key and chunk index pair.
+             */
+            struct KeyHash
+            {
+                size_t operator()(const key_type &key) const
+                {
+                    return std::hash<IndexKey>()(key.first) ^ (key.second * size_t(0x9E3779B97F4A7C15ULL));
+                }
+            };
+
+            typedef std::list<std::pair<key_type, block_type>> list_type;
+
+            // The maximum number of decoded bytes held.
+            const size_t capacity_;
+
+            // The decoded bytes currently held.
+            size_t bytes = 0;
+
+            // The entries, most recently used first.
+            list_type entries;
+
+            // The position of each entry in the list.
+            std::unordered_map<key_type, list_type::iterator, KeyHash> lookup;
+
+            // Guards the entries.
+            mutable std::mutex mutex;
+
+            // The number of lookups that found a chunk.
+            std::atomic<size_t> hits{ 0 };
+
+            // The number of lookups that didn't.
+            std::atomic<size_t> misses{ 0 };
+
+            /**
+             * Drops the least recently used entries until the cache is within budget.
+             */
+            void evict()
+            {
+                while (bytes > capacity_ && !entries.empty())
+                {
+                    bytes -= entries.back().second->size();
+                    lookup.erase(entries.back().first);
+                    entries.pop_back();
+                }
+            }
+
+        public:
+            /**
+             * Constructor. The capacity is in decoded bytes.
+             */
+            BlockCache(size_t capacity)
+                : capacity_(capacity)
+            {
+            }
+
+            /**
+             * Copy constructor.
+             */
+            BlockCache(const BlockCache &) = delete;
+
+            /**
+             * Copy operator.
+             */
+            BlockCache &operator= (const BlockCache &) = delete;
+
+            /**
+             * Destructor.
+             */
+            virtual ~BlockCache() = default;
+
+            /**
+             * The maximum number of decoded bytes held.
+             */
+            size_t capacity() const
+            {
+                return capacity_;
+            }
+
+            /**
+             * Finds a decoded chunk, or returns nullptr if it isn't cached.
+             */
+            block_type find(const IndexKey &key, size_t chunk)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                auto it = lookup.find(std::make_pair(key, chunk));
+
+                if (it == lookup.end())
+                {
+                    ++misses;
+                    return nullptr;
+                }
+
+                entries.splice(entries.begin(), entries, it->second);
+                ++hits;
+
+                return it->second->second;
+            }
+
+            /**
+             * Adds a decoded chunk. Chunks larger than the capacity are not kept.
+             */
+            void insert(const IndexKey &key, size_t chunk, block_type block)
+            {
+                if (block->size() > capacity_)
+                {
+                    return;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                auto id = std::make_pair(key, chunk);
+                auto it = lookup.find(id);
+
+                if (it != lookup.end())
+                {
+                    bytes -= it->second->second->size();
+                    entries.erase(it->second);
+                    lookup.erase(it);
+                }
+
+                entries.emplace_front(id, block);
+                lookup.emplace(id, entries.begin());
+                bytes += block->size();
+
+                evict();
+            }
+
+            /**
+             * Drops every entry. The counters are kept.
+             */
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                entries.clear();
+                lookup.clear();
+                bytes = 0;
+            }
+
+            /**
+             * The current counters.
+             */
+            Statistics statistics() const
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                return{ hits, misses, bytes, entries.size() };
+            }
+        };
+    }
+}
\ No newline at end of file
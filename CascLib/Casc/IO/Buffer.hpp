@@ -19,9 +19,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <iterator>
 #include <memory>
 #include <sstream>
 #include <stdint.h>
@@ -32,6 +35,14 @@
 
 #include "../md5.hpp"
 #include "../zlib.hpp"
+#include "../Crypto/Lookup3.hpp"
+#include "../Crypto/KeyStore.hpp"
+
+#include "../Key.hpp"
+#include "../ThreadPool.hpp"
+
+#include "BlockCache.hpp"
+#include "Verification.hpp"
 
 #include "Handler.hpp"
 #include "Endian.hpp"
@@ -51,28 +62,71 @@ namespace Casc
             static const size_t DataHeaderSize = 30U;
             static const size_t BufferSize = 4096U;
 
+            // The number of bytes read at open, enough for the headers
+            // and the block table of most files.
+            static const size_t HeaderReadSize = 4096U;
+
+            // The most data read from a file source with one call.
+            static const size_t CoalesceSize = 1024U * 1024U;
+
             // The underlying stream buffer.
             std::shared_ptr<std::fstream> fbuf;
 
+            // The data file the buffer reads from.
+            std::shared_ptr<DataSource> file;
+
             // True when the file is properly initialized.
             // The file is properly initialized once all the headers have been read.
             bool isInitialized = false;
 
             // The logical size of the file.
-            size_t length;
+            size_t length = 0;
 
             // The offset of the file.
-            size_t offset;
+            size_t offset = 0;
 
-            // The offset of the buffer.
-            size_t current;
+            // The logical offset of the start of the get area.
+            size_t current = 0;
 
             // The buffer.
             std::vector<char> buf;
 
-            // Chunk handlers.
+            // The chunks from the block table.
+            std::vector<Chunk> chunks;
+
+            // Chunk handlers, created when the chunk is first read.
             std::vector<std::shared_ptr<Handler>> handlers;
 
+            // The headers, when the data file can't be viewed in place.
+            std::vector<char> headerBuffer;
+
+            // The logical offset where each handler starts, followed by the length.
+            std::vector<size_t> starts;
+
+            // Decodes chunks concurrently in readRange, if set.
+            std::shared_ptr<ThreadPool> pool;
+
+            // Shares decoded chunks with other buffers, if set.
+            std::shared_ptr<BlockCache> cache;
+
+            // The key of the file, used to look up its chunks in the cache.
+            IndexKey key;
+
+            // How much of the file is checked against its checksums.
+            Verification verification = Verification::None;
+
+            // The keys encrypted chunks are decrypted with, if set.
+            std::shared_ptr<const Crypto::KeyStore> keys;
+
+            // The handler the get area points into, if it points at a view.
+            size_t viewing = SIZE_MAX;
+
+            // The offset of the first chunk in the data file.
+            size_t dataOffset = 0;
+
+            // True for each chunk that has been read into memory from a file source.
+            std::vector<bool> loaded;
+
             /**
              * Read the header for the current file, create handlers
              * and confirm checksums.
@@ -80,193 +134,419 @@ namespace Casc
             void init()
             {
                 handlers.clear();
+                chunks.clear();
+                starts.clear();
                 length = 0;
                 current = 0;
+                viewing = SIZE_MAX;
 
-                std::array<char, DataHeaderSize> dataHeader;
-                fbuf->read(dataHeader.data(), DataHeaderSize);
-                this->offset += 30;
+                setg(nullptr, nullptr, nullptr);
 
-                std::array<uint8_t, 16> blockTableChecksum;
-                std::copy(dataHeader.data(), dataHeader.data() + 16, blockTableChecksum.begin());
-                std::reverse(blockTableChecksum.begin(), blockTableChecksum.end());
-                auto size = Endian::read<EndianType::Little, uint32_t>(dataHeader.data() + 16);
+                if (this->offset >= file->upper_bound - file->lower_bound)
+                {
+                    throw Exceptions::IOException("Unexpected end of data file.");
+                }
 
-                MD5 blockTableVerficiation;
+                // The headers and the block table are read together, with a second
+                // read only for block tables that don't fit in the first one.
+                auto prefix = std::min(size_t(HeaderReadSize), file->upper_bound - file->lower_bound - this->offset);
+                auto headers = readHeaders(prefix);
 
-                std::array<char, 8> header;
-                fbuf->read(header.data(), header.size());
-                this->offset += 8;
+                if (prefix < DataHeaderSize + 8)
+                {
+                    throw Exceptions::IOException("Unexpected end of data file.");
+                }
 
-                blockTableVerficiation.update(header.data(), header.size());
+                // The data header starts with the file key, reversed.
+                FileKey fileKey(std::make_reverse_iterator(headers + 16), std::make_reverse_iterator(headers));
+                auto size = Endian::read<EndianType::Little, uint32_t>(headers + 16);
 
-                auto blockTableSize = getBlockTableSize(header.begin());
-                this->offset += blockTableSize;
+                auto blockTableSize = getBlockTableSize(headers + DataHeaderSize);
 
-                if (blockTableSize > 0)
+                if (DataHeaderSize + 8 + blockTableSize > prefix)
                 {
-                    std::vector<char> blockTable(blockTableSize);
-                    fbuf->read(blockTable.data(), blockTableSize);
-
-                    blockTableVerficiation.update(blockTable);
-                    blockTableVerficiation.finalize();
-
-                    // TODO: Compare checksums
+                    headers = readHeaders(DataHeaderSize + 8 + blockTableSize);
+                }
 
-                    auto chunks = parseBlockTable(blockTable.cbegin(), blockTable.cend());
+                // With a block table the file key is the MD5 of the block table.
+                if (blockTableSize > 0 && verification != Verification::None)
+                {
+                    verify(fileKey, headers + DataHeaderSize, 8 + blockTableSize);
+                }
 
-                    for (auto &chunk : chunks)
-                    {
-                        fbuf->seekg(this->offset + chunk.offset);
-                        EncodingMode mode = (EncodingMode)fbuf->get();
+                this->offset += DataHeaderSize + 8 + blockTableSize;
+                dataOffset = this->offset;
 
-                        auto source = std::make_shared<Impl::StreamSource>(fbuf, std::make_pair(this->offset + chunk.offset, this->offset + chunk.offset + chunk.size));
+                if (blockTableSize > 0)
+                {
+                    // The handlers are created when their chunk is first read.
+                    auto table = headers + DataHeaderSize + 8;
 
-                        handlers.push_back(createHandler(mode, chunk, source));
-                    }
+                    chunks = parseBlockTable(table, table + blockTableSize);
+                    handlers.resize(chunks.size());
                 }
                 else
                 {
-                    auto offset = fbuf->tellg();
+                    auto source = file->slice(this->offset, size - DataHeaderSize - 8);
 
-                    if (offset < 0)
+                    // Without one it is the MD5 of the whole file.
+                    if (verification == Verification::Full)
                     {
-                        throw Exceptions::IOException("Negative stream offset is invalid.");
+                        source = verify(source, fileKey, headers + DataHeaderSize, 8);
                     }
 
-                    EncodingMode mode = (EncodingMode)fbuf->get();
-                    auto source = std::make_shared<Impl::StreamSource>(fbuf, std::make_pair(size_t(offset), size_t(offset) + size));
+                    EncodingMode mode = (EncodingMode)source->get(0, 1).at(0);
 
-                    handlers.push_back(createHandler(mode, source));
+                    handlers.push_back(cached(createHandler(mode, source, keys.get()), source, 0));
+                    chunks.push_back(handlers.back()->chunk);
                 }
 
-                for (auto &handler : handlers)
+                for (auto &chunk : chunks)
                 {
-                    length += handler->logicalSize();
+                    starts.push_back(length);
+                    length += chunk.end - chunk.begin;
+                }
+
+                starts.push_back(length);
+
+                loaded.assign(chunks.size(), false);
+                headerBuffer.clear();
+
+                // A file without a block table has no checksum for its only chunk,
+                // which has been read into memory already if it was verified.
+                if (blockTableSize == 0 && verification == Verification::Full)
+                {
+                    loaded[0] = true;
                 }
             }
 
             /**
-             * The current position in the stream.
+             * Points at count bytes from the start of the file, reading them into
+             * the header buffer if the data file can't be viewed in place.
              */
-            pos_type pos()
+            const char *readHeaders(size_t count)
             {
-                return pos_type(current + gptr() - eback());
+                if (auto view = file->view(this->offset, count))
+                {
+                    return view;
+                }
+
+                headerBuffer = read(this->offset, count);
+
+                return headerBuffer.data();
             }
 
             /**
-             * Seeks within the current buffer.
+             * Gets the handler for a chunk, reading the mode byte and
+             * creating the handler the first time.
              */
-            pos_type seekbuf(off_type offset, std::ios_base::seekdir dir = std::ios_base::cur)
+            const std::shared_ptr<Handler> &handler(size_t index)
             {
-                switch (dir)
+                auto &entry = handlers[index];
+
+                if (entry == nullptr)
                 {
-                case std::ios_base::cur:
-                    setg(eback(), gptr() + offset, egptr());
-                    break;
+                    auto &chunk = chunks[index];
+                    entry = createHandler(index, file->slice(dataOffset + chunk.offset, chunk.size));
+                }
 
-                case std::ios_base::beg:
-                    setg(eback(), eback() + offset, egptr());
-                    break;
+                return entry;
+            }
 
-                case std::ios_base::end:
-                    setg(eback(), egptr() - offset, egptr());
-                    break;
+            /**
+             * Creates the handler for a chunk. If every chunk is verified, the handler
+             * checks the chunk when it first decodes it, so a chunk found in the block
+             * cache isn't hashed again.
+             */
+            std::shared_ptr<Handler> createHandler(size_t index, std::shared_ptr<DataSource> source)
+            {
+                char mode;
 
-                default:
-                    throw Exceptions::IOException("Unsupported seek dir.");
+                if (source->read(0, &mode, 1) != 1)
+                {
+                    throw Exceptions::IOException("Unexpected end of data file.");
                 }
 
-                return pos();
+                auto handler = createHandler((EncodingMode)mode, chunks[index], source, keys.get(), index);
+
+                if (verification == Verification::Full)
+                {
+                    handler->verifyOnDecode(key);
+                }
+
+                return cached(handler, source, index);
             }
 
             /**
-             * Seeks relatively within the file.
+             * Throws if the MD5 of some data doesn't match the expected checksum.
              */
-            pos_type seekrel(off_type offset, std::ios_base::seekdir dir = std::ios_base::cur)
+            void verify(const FileKey &expected, const char *data, size_t count,
+                const char *prefix = nullptr, size_t prefixSize = 0) const
             {
-                if (dir != std::ios_base::cur || offset == 0)
+                MD5 md5;
+
+                if (prefixSize > 0)
                 {
-                    return pos();
+                    md5.update(prefix, static_cast<MD5::size_type>(prefixSize));
                 }
 
-                auto newOffset = pos() + offset;
+                md5.update(data, static_cast<MD5::size_type>(count));
+                md5.finalize();
 
-                if (newOffset >= current && newOffset < current + 4096)
+                verify(expected, md5.rawdigest());
+            }
+
+            /**
+             * Throws if a digest doesn't match the expected checksum.
+             */
+            void verify(const FileKey &expected, const std::array<unsigned char, 16> &digest) const
+            {
+                FileKey actual(digest.begin(), digest.end());
+
+                if (actual != expected)
                 {
-                    return seekbuf(offset, dir);
+                    throw Exceptions::InvalidHashException(Crypto::lookup3(expected, 0), Crypto::lookup3(actual, 0), key.string());
                 }
-
-                return buffer(pos() + offset);
             }
 
             /**
-             * Seeks absolutely within the file.
+             * Checks the whole of a source against a checksum, optionally preceded by
+             * a prefix. A source that can't be viewed in place is read into memory
+             * first, and the returned source reads from that memory, so the data is
+             * only read once.
              */
-            pos_type seekabs(off_type offset, std::ios_base::seekdir dir = std::ios_base::beg)
+            std::shared_ptr<DataSource> verify(std::shared_ptr<DataSource> source, const FileKey &expected,
+                const char *prefix = nullptr, size_t prefixSize = 0) const
             {
-                if (dir != std::ios_base::beg && dir != std::ios_base::end)
+                auto size = source->upper_bound - source->lower_bound;
+                auto data = source->view(0, size);
+
+                if (data == nullptr)
                 {
-                    return pos();
+                    auto block = std::make_shared<std::vector<char>>(size);
+
+                    if (source->read(0, block->data(), size) != size)
+                    {
+                        throw Exceptions::IOException("Unexpected end of data file.");
+                    }
+
+                    source = std::make_shared<Impl::MemoryMappedSource>(block);
+                    data = block->data();
                 }
 
-                if (dir == std::ios_base::end)
+                verify(expected, data, size, prefix, prefixSize);
+
+                return source;
+            }
+
+            /**
+             * Puts a handler behind the block cache, if there is one. Stored chunks
+             * are left alone since they can be read from the data file directly.
+             */
+            std::shared_ptr<Handler> cached(std::shared_ptr<Handler> handler,
+                std::shared_ptr<DataSource> source, size_t index) const
+            {
+                if (cache == nullptr || handler->mode() == EncodingMode::None)
                 {
-                    offset = length - offset;
+                    return handler;
                 }
 
-                if (offset >= current && offset < current + 4096)
+                return std::make_shared<Impl::CachedHandler>(handler, source, cache, key, index);
+            }
+
+            /**
+             * Checks if a chunk should be read into memory by prefetch.
+             */
+            bool prefetchable(size_t index) const
+            {
+                return !loaded[index] && index != viewing &&
+                    chunks[index].size > 0 && chunks[index].size <= CoalesceSize;
+            }
+
+            /**
+             * Reads the chunks in [first, last) into memory when the data file is read
+             * by offset. Adjacent chunks are read with one call, up to CoalesceSize bytes
+             * at a time, and their handlers are replaced with ones reading from memory.
+             */
+            void prefetch(size_t first, size_t last)
+            {
+                if (file->type != DataSourceType::File)
                 {
-                    return seekbuf(offset - current, std::ios_base::beg);
+                    return;
                 }
 
-                return buffer(offset);
+                for (auto i = first; i < last;)
+                {
+                    if (!prefetchable(i))
+                    {
+                        ++i;
+                        continue;
+                    }
+
+                    std::vector<std::shared_ptr<std::vector<char>>> blocks;
+                    std::vector<std::pair<char*, size_t>> buffers;
+                    size_t total = 0;
+                    auto begin = i;
+
+                    // The chunks are stored back to back.
+                    for (; i < last && prefetchable(i) && total + chunks[i].size <= CoalesceSize; ++i)
+                    {
+                        blocks.push_back(std::make_shared<std::vector<char>>(chunks[i].size));
+                        buffers.emplace_back(blocks.back()->data(), blocks.back()->size());
+                        total += chunks[i].size;
+                    }
+
+                    if (file->read(dataOffset + chunks[begin].offset, buffers) != total)
+                    {
+                        throw Exceptions::IOException("Unexpected end of data file.");
+                    }
+
+                    for (auto k = begin; k < i; ++k)
+                    {
+                        handlers[k] = createHandler(k, std::make_shared<Impl::MemoryMappedSource>(blocks[k - begin]));
+                        loaded[k] = true;
+                    }
+                }
             }
 
             /**
-             * Seeks within the file.
+             * Reads bytes from the data file, throws if they are not available.
              */
-            pos_type seek(off_type offset, std::ios_base::seekdir dir = std::ios_base::cur)
+            std::vector<char> read(size_t offset, size_t count) const
             {
-                if (dir == std::ios_base::cur)
+                auto v = file->get(offset, count);
+
+                if (v.size() != count)
                 {
-                    return seekrel(offset, dir);
+                    throw Exceptions::IOException("Unexpected end of data file.");
                 }
-                else
+
+                return v;
+            }
+
+            /**
+             * The current position in the stream.
+             */
+            pos_type pos() const
+            {
+                return pos_type(current + (gptr() - eback()));
+            }
+
+            /**
+             * Finds the handler for a logical offset before the end of the file.
+             */
+            size_t findHandler(size_t offset) const
+            {
+                return size_t(std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin()) - 1;
+            }
+
+            /**
+             * Lets go of the decoded chunks a read has moved past. The last chunk,
+             * where the next read likely continues, and the chunk the get area
+             * points into are kept.
+             */
+            void release(size_t first, size_t last)
+            {
+                for (auto i = first; i + 1 < last; ++i)
                 {
-                    return seekabs(offset, dir);
+                    if (handlers[i] != nullptr && i != viewing)
+                    {
+                        handlers[i]->reset();
+                    }
                 }
             }
 
             /**
-             * Read the decompressed data from the current chunk into the buffer.
+             * Decodes a range of the file straight into dest and returns the number of bytes written.
              */
-            pos_type buffer(off_type offset)
+            size_t decodeRange(size_t offset, char *dest, size_t count)
             {
-                auto count = 0U;
+                size_t written = 0;
+                auto first = findHandler(offset);
+                auto i = first;
 
-                for (auto &handler : handlers)
+                for (; i < handlers.size() && written < count; ++i)
                 {
-                    if (count < BufferSize && ((handler->chunk.begin < offset
-                        && handler->chunk.end > offset) || handler->chunk.begin >= offset))
+                    auto local = offset + written - starts[i];
+                    auto n = std::min(count - written, starts[i + 1] - starts[i] - local);
+
+                    if (n == 0)
                     {
-                        auto begin = (handler->chunk.begin < offset
-                            && handler->chunk.end > offset) ? size_t(offset - handler->chunk.begin) : 0;
-                        auto decoded = handler->decode(begin, BufferSize - count);
+                        continue;
+                    }
+
+                    auto decoded = handler(i)->decode(local, dest + written, n);
+                    written += decoded;
 
-                        std::memcpy(buf.data() + count, decoded.data(), decoded.size());
-                        count += decoded.size();
+                    if (decoded < n)
+                    {
+                        ++i;
+                        break;
                     }
                 }
 
-                if (count < BufferSize)
+                release(first, i);
+
+                return written;
+            }
+
+            /**
+             * Makes the data at an offset available in the get area. Points at the
+             * decoded chunk directly when the handler has it in memory, otherwise
+             * decodes up to BufferSize bytes into the buffer.
+             */
+            void fill(size_t offset)
+            {
+                auto index = findHandler(offset);
+                auto local = offset - starts[index];
+                auto available = starts[index + 1] - offset;
+
+                prefetch(index, index + 1);
+
+                // Lets go of the chunk the get area pointed into.
+                if (viewing != SIZE_MAX && viewing != index)
+                {
+                    handlers[viewing]->reset();
+                }
+
+                if (auto view = handler(index)->view(local, available))
+                {
+                    // The get area is never written to.
+                    auto begin = const_cast<char*>(view);
+                    setg(begin, begin, begin + available);
+                    viewing = index;
+                }
+                else
+                {
+                    auto count = decodeRange(offset, buf.data(), std::min(size_t(BufferSize), length - offset));
+                    setg(buf.data(), buf.data(), buf.data() + count);
+                    viewing = SIZE_MAX;
+                }
+
+                current = offset;
+            }
+
+            /**
+             * Moves to an offset in the file, keeping the get area if the offset is inside it.
+             */
+            pos_type seekabs(off_type offset)
+            {
+                if (offset < 0 || size_t(offset) > length)
                 {
-                    std::memset(buf.data() + count, 0, BufferSize - count);
+                    return pos_type(off_type(-1));
                 }
 
-                setg(buf.data(), buf.data(), buf.data() + count);
+                auto target = size_t(offset);
 
-                current = size_t(offset);
+                if (eback() != nullptr && target >= current && target <= current + size_t(egptr() - eback()))
+                {
+                    setg(eback(), eback() + (target - current), egptr());
+                }
+                else
+                {
+                    setg(nullptr, nullptr, nullptr);
+                    current = target;
+                }
 
                 return pos();
             }
@@ -281,7 +561,20 @@ namespace Casc
             pos_type seekoff(off_type off, std::ios_base::seekdir dir,
                 std::ios_base::openmode which = std::ios_base::in) override
             {
-                return seek(off, dir);
+                switch (dir)
+                {
+                case std::ios_base::beg:
+                    return seekabs(off);
+
+                case std::ios_base::cur:
+                    return seekabs(off_type(pos()) + off);
+
+                case std::ios_base::end:
+                    return seekabs(off_type(length) + off);
+
+                default:
+                    return pos_type(off_type(-1));
+                }
             }
 
             std::streamsize showmanyc() override
@@ -291,55 +584,77 @@ namespace Casc
 
             int_type underflow() override
             {
-                if (pos() == pos_type(length))
+                if (gptr() < egptr())
                 {
-                    setg(nullptr, nullptr, nullptr);
-                    return traits_type::eof();
+                    return traits_type::to_int_type(*gptr());
                 }
 
-                buffer(pos());
-                return traits_type::to_int_type(buf[0]);
-            }
+                auto offset = size_t(pos());
 
-            int_type uflow() override
-            {
-                if (pos() == pos_type(length))
+                if (offset >= length)
                 {
-                    setg(nullptr, nullptr, nullptr);
                     return traits_type::eof();
                 }
 
-                buffer(pos());
-                seekbuf(1);
+                fill(offset);
+
+                if (gptr() == egptr())
+                {
+                    return traits_type::eof();
+                }
 
-                return traits_type::to_int_type(buf[1]);
+                return traits_type::to_int_type(*gptr());
             }
 
             std::streamsize xsgetn(char_type* s, std::streamsize count) override
             {
                 std::streamsize copied = 0;
 
-                if (count <= showmanyc())
+                while (copied < count)
                 {
-                    std::memcpy(s, gptr(), static_cast<size_t>(count));
-                    seekbuf(count);
-                    copied = count;
-                }
-                else
-                {
-                    do
+                    auto available = egptr() - gptr();
+
+                    if (available > 0)
+                    {
+                        auto n = std::min<std::streamsize>(available, count - copied);
+                        std::memcpy(s + copied, gptr(), static_cast<size_t>(n));
+                        setg(eback(), gptr() + n, egptr());
+                        copied += n;
+                        continue;
+                    }
+
+                    auto offset = size_t(pos());
+
+                    if (offset >= length)
                     {
-                        if (showmanyc() == 0)
+                        break;
+                    }
+
+                    auto remaining = std::min(static_cast<size_t>(count - copied), length - offset);
+
+                    if (remaining >= BufferSize)
+                    {
+                        // Large reads skip the buffer and decode into the caller's memory.
+                        auto n = readRange(offset, s + copied, remaining);
+
+                        setg(nullptr, nullptr, nullptr);
+                        current = offset + n;
+                        copied += n;
+
+                        if (n < remaining)
                         {
-                            buffer(pos());
+                            break;
                         }
+                    }
+                    else
+                    {
+                        fill(offset);
 
-                        auto numRead = std::min<size_t>(
-                            static_cast<size_t>(showmanyc()), static_cast<size_t>(count - copied));
-                        std::memcpy(s + copied, gptr(), numRead);
-                        copied += numRead;
-                        seekbuf(numRead);
-                    } while (copied < count && underflow() != traits_type::eof());
+                        if (gptr() == egptr())
+                        {
+                            break;
+                        }
+                    }
                 }
 
                 return copied;
@@ -382,13 +697,12 @@ namespace Casc
             {
                 this->isInitialized = false;
 
-                if (!fbuf->is_open())
+                if (!is_open())
                 {
                     throw Exceptions::IOException("Buffer is not open.");
                 }
 
                 this->offset = offset;
-                fbuf->seekg(offset);
 
                 this->init();
 
@@ -407,15 +721,138 @@ namespace Casc
                     throw Exceptions::IOException("Couldn't open buffer.");
                 }
 
+                fbuf->seekg(0, std::ios_base::end);
+                auto size = fbuf->tellg();
+
+                if (size < 0)
+                {
+                    throw Exceptions::IOException("Negative stream offset is invalid.");
+                }
+
+                file = std::make_shared<Impl::StreamSource>(fbuf, std::make_pair(size_t(0), size_t(size)));
+
+                open(offset);
+            }
+
+            /**
+             * Reads a file from an offset in a data file that is already open,
+             * such as a memory mapped data file shared between buffers.
+             * Decoded chunks are shared through the cache under the given key, if set,
+             * and the file is checked against its checksums as the verification asks.
+             * Encrypted chunks are decrypted with the given keys.
+             */
+            void open(std::shared_ptr<DataSource> file, size_t offset,
+                std::shared_ptr<ThreadPool> pool = nullptr,
+                std::shared_ptr<BlockCache> cache = nullptr, const IndexKey &key = IndexKey(),
+                Verification verification = Verification::None,
+                std::shared_ptr<const Crypto::KeyStore> keys = nullptr)
+            {
+                this->file = file;
+                this->pool = pool;
+                this->cache = cache;
+                this->key = key;
+                this->verification = verification;
+                this->keys = keys;
+
                 open(offset);
             }
 
+            /**
+             * Decodes count bytes from an offset in the file into dest and returns the
+             * number of bytes written. Doesn't move the read position.
+             *
+             * When the buffer has a thread pool and the data file is memory mapped
+             * or read by offset, the chunks in the range are decoded concurrently.
+             */
+            size_t readRange(size_t offset, char *dest, size_t count)
+            {
+                if (offset >= length || count == 0)
+                {
+                    return 0;
+                }
+
+                count = std::min(count, length - offset);
+
+                auto first = findHandler(offset);
+                auto last = findHandler(offset + count - 1) + 1;
+
+                // Lets the system read ahead while the first chunks are decoded.
+                auto begin = chunks[first].offset;
+                auto end = chunks[last - 1].offset + chunks[last - 1].size;
+
+                if (end > begin)
+                {
+                    file->willNeed(dataOffset + begin, end - begin);
+                }
+
+                prefetch(first, last);
+
+                if (pool == nullptr || pool->size() < 2 || last - first < 2 ||
+                    file->type == DataSourceType::Stream)
+                {
+                    return decodeRange(offset, dest, count);
+                }
+
+                std::vector<size_t> written(last - first);
+
+                pool->parallelFor(last - first, [&](size_t i)
+                {
+                    auto index = first + i;
+                    auto begin = std::max(starts[index], offset);
+                    auto end = std::min(starts[index + 1], offset + count);
+
+                    if (begin < end)
+                    {
+                        written[i] = handler(index)->decode(begin - starts[index], dest + (begin - offset), end - begin);
+                    }
+                });
+
+                release(first, last);
+
+                // Only report the bytes up to the first chunk that came up short.
+                size_t total = 0;
+
+                for (auto i = 0U; i < written.size(); ++i)
+                {
+                    auto index = first + i;
+                    auto expected = std::min(starts[index + 1], offset + count) - std::max(starts[index], offset);
+
+                    total += written[i];
+
+                    if (written[i] < expected)
+                    {
+                        break;
+                    }
+                }
+
+                return total;
+            }
+
+            /**
+             * Decodes the whole file.
+             */
+            std::vector<char> readAll()
+            {
+                std::vector<char> v(length);
+                v.resize(readRange(0, v.data(), v.size()));
+
+                return v;
+            }
+
+            /**
+             * The logical size of the file.
+             */
+            size_t size() const
+            {
+                return length;
+            }
+
             /**
              * Checks if the buffer is open.
              */
             bool is_open() const
             {
-                return fbuf->is_open();
+                return file != nullptr;
             }
 
             /**
@@ -425,6 +862,14 @@ namespace Casc
             {
                 setg(nullptr, nullptr, nullptr);
 
+                handlers.clear();
+                chunks.clear();
+                starts.clear();
+                loaded.clear();
+                file = nullptr;
+                cache = nullptr;
+                viewing = SIZE_MAX;
+
                 if (fbuf->is_open())
                 {
                     fbuf->close();
@@ -473,15 +918,13 @@ namespace Casc
                 {
                     auto physicalSize = Endian::read<EndianType::Big, uint32_t>(it);
                     auto logicalSize = Endian::read<EndianType::Big, uint32_t>(it + 4);
-                    std::array<char, 16> checksumBytes;
-                    std::copy(it + 8, it + 24, checksumBytes.begin());
 
                     chunks.push_back({
                         chunks.size() > 0 ? chunks.rbegin()->end : 0,
                         chunks.size() > 0 ? chunks.rbegin()->end + logicalSize : logicalSize,
                         chunks.size() > 0 ? chunks.rbegin()->offset + chunks.rbegin()->size : 0,
                         physicalSize,
-                        checksumBytes
+                        FileKey(it + 8, it + 24)
                     });
                 }
 
@@ -491,7 +934,8 @@ namespace Casc
             /**
              * Create the handler for an encoding mode.
              */
-            static std::shared_ptr<Handler> createHandler(EncodingMode mode, Chunk chunk, std::shared_ptr<DataSource> source)
+            static std::shared_ptr<Handler> createHandler(EncodingMode mode, Chunk chunk, std::shared_ptr<DataSource> source,
+                const Crypto::KeyStore *keys, size_t index)
             {
                 switch (mode)
                 {
@@ -502,7 +946,7 @@ namespace Casc
                     return std::make_shared<Impl::ZlibHandler>(chunk, source);
 
                 case EncodingMode::Crypt:
-                    return std::make_shared<Impl::CryptHandler>(chunk, source);
+                    return std::make_shared<Impl::CryptHandler>(chunk, source, keys, index);
 
                 default:
                     throw Exceptions::InvalidEncodingModeException(mode);
@@ -512,7 +956,8 @@ namespace Casc
             /**
             * Create the handler for an encoding mode.
             */
-            static std::shared_ptr<Handler> createHandler(EncodingMode mode, std::shared_ptr<DataSource> source)
+            static std::shared_ptr<Handler> createHandler(EncodingMode mode, std::shared_ptr<DataSource> source,
+                const Crypto::KeyStore *keys)
             {
                 switch (mode)
                 {
@@ -523,7 +968,7 @@ namespace Casc
                     return std::make_shared<Impl::ZlibHandler>(source);
 
                 case EncodingMode::Crypt:
-                    return std::make_shared<Impl::CryptHandler>(source);
+                    return std::make_shared<Impl::CryptHandler>(source, keys);
 
                 default:
                     throw Exceptions::InvalidEncodingModeException(mode);
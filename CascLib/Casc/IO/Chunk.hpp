@@ -19,7 +19,7 @@
 
 #pragma once
 
-#include "../Hex.hpp"
+#include "../Key.hpp"
 
 namespace Casc
 {
@@ -39,8 +39,8 @@ namespace Casc
             // The size of the compressed data.
             size_t size;
 
-            // The checksum of the data.
-            Hex checksum;
+            // The MD5 checksum of the encoded data.
+            FileKey checksum;
 
             bool operator <(const Chunk &b) const
             {
@@ -19,9 +19,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "../zlib.hpp"
+#include "../Exceptions.hpp"
 
 namespace Casc
 {
@@ -33,7 +37,8 @@ namespace Casc
         enum class DataSourceType
         {
             MemoryMapped,
-            Stream
+            Stream,
+            File
         };
 
         /**
@@ -54,10 +59,78 @@ namespace Casc
              */
             virtual ~DataSource() { }
 
+            /**
+             * Copies up to count bytes into dest and returns the number of bytes copied.
+             * The offset is relative to the lower bound.
+             */
+            virtual size_t read(size_t offset, char *dest, size_t count) = 0;
+
+            /**
+             * Reads a contiguous range starting at an offset into several buffers,
+             * filling each before moving to the next, and returns the number of bytes read.
+             * Sources backed by a file do this with a single call.
+             */
+            virtual size_t read(size_t offset, const std::vector<std::pair<char*, size_t>> &buffers)
+            {
+                size_t total = 0;
+
+                for (auto &buffer : buffers)
+                {
+                    if (offset + total >= upper_bound - lower_bound)
+                    {
+                        break;
+                    }
+
+                    auto n = read(offset + total, buffer.first, buffer.second);
+                    total += n;
+
+                    if (n < buffer.second)
+                    {
+                        break;
+                    }
+                }
+
+                return total;
+            }
+
+            /**
+             * Points directly at count bytes of the source, or returns nullptr
+             * if the source isn't held in memory or has fewer bytes left.
+             */
+            virtual const char *view(size_t, size_t) const
+            {
+                return nullptr;
+            }
+
+            /**
+             * Tells the system that a range will be read soon, so it can start
+             * reading it from disk in the background. Does nothing by default.
+             */
+            virtual void willNeed(size_t, size_t) const
+            {
+            }
+
             /**
              * Gets a chunk of data.
              */
-            virtual std::vector<char> get(size_t offset, size_t count) = 0;
+            std::vector<char> get(size_t offset, size_t count)
+            {
+                if (offset >= (upper_bound - lower_bound))
+                {
+                    throw Exceptions::IOException("Invalid offset");
+                }
+
+                std::vector<char> v(std::min(count, upper_bound - lower_bound - offset));
+                v.resize(read(offset, v.data(), v.size()));
+
+                return v;
+            }
+
+            /**
+             * Creates a source for a part of this source.
+             * The offset is relative to the lower bound.
+             */
+            virtual std::shared_ptr<DataSource> slice(size_t offset, size_t count) const = 0;
 
             /**
              * The type of data source.
@@ -78,4 +151,5 @@ namespace Casc
 }
 
 #include "Impl/MemoryMappedSource.hpp"
-#include "Impl/StreamSource.hpp"
\ No newline at end of file
+#include "Impl/StreamSource.hpp"
+#include "Impl/FileSource.hpp"
\ No newline at end of file
@@ -24,6 +24,8 @@
 
 #include "../zlib.hpp"
 #include "../md5.hpp"
+#include "../Exceptions.hpp"
+#include "../Crypto/Lookup3.hpp"
 
 #include "Chunk.hpp"
 #include "DataSource.hpp"
@@ -38,9 +40,72 @@ namespace Casc
          */
         class Handler
         {
+            // Set while the encoded chunk still has to be checked before it is decoded.
+            bool unverified = false;
+
+            // The file the chunk belongs to, named if the check fails.
+            IndexKey file;
+
+            /**
+             * The MD5 of count encoded bytes.
+             */
+            static FileKey digest(const char *data, size_t count)
+            {
+                MD5 md5;
+                md5.update(data, static_cast<MD5::size_type>(count));
+                md5.finalize();
+
+                auto digest = md5.rawdigest();
+
+                return FileKey(digest.begin(), digest.end());
+            }
+
         protected:
             std::shared_ptr<DataSource> source;
 
+            /**
+             * Checks the encoded chunk against its checksum the first time it is called
+             * after verifyOnDecode, and throws if they don't match. A source that can't be
+             * viewed in place is read into memory and replaced, so the decode that follows
+             * reads the bytes that were hashed instead of the data file again. Returns true
+             * if the source was replaced.
+             */
+            bool verify()
+            {
+                if (!unverified)
+                {
+                    return false;
+                }
+
+                auto size = source->upper_bound - source->lower_bound;
+                auto data = source->view(0, size);
+                auto replaced = data == nullptr;
+
+                if (replaced)
+                {
+                    auto block = std::make_shared<std::vector<char>>(size);
+
+                    if (source->read(0, block->data(), size) != size)
+                    {
+                        throw Exceptions::IOException("Unexpected end of data file.");
+                    }
+
+                    source = std::make_shared<Impl::MemoryMappedSource>(block);
+                    data = block->data();
+                }
+
+                auto actual = digest(data, size);
+
+                if (actual != chunk.checksum)
+                {
+                    throw Exceptions::InvalidHashException(Crypto::lookup3(chunk.checksum, 0), Crypto::lookup3(actual, 0), file.string());
+                }
+
+                unverified = false;
+
+                return replaced;
+            }
+
         public:
             /**
             * Chunk metadata.
@@ -63,15 +128,50 @@ namespace Casc
              */
             virtual EncodingMode mode() const = 0;
 
+            /**
+             * Decodes up to count bytes into dest and returns the number of bytes written.
+             */
+            virtual size_t decode(size_t offset, char *dest, size_t count) = 0;
+
+            /**
+             * Points directly at count decoded bytes, or returns nullptr
+             * if the decoded data isn't held in memory.
+             */
+            virtual const char *view(size_t, size_t)
+            {
+                return nullptr;
+            }
+
             /**
              * Decodes a chunk of data.
              */
-            virtual std::vector<char> decode(size_t offset, size_t count) = 0;
+            std::vector<char> decode(size_t offset, size_t count)
+            {
+                auto size = logicalSize();
+
+                if (offset >= size)
+                {
+                    throw Exceptions::IOException("Invalid offset.");
+                }
+
+                std::vector<char> v(std::min(count, size - offset));
+                v.resize(decode(offset, v.data(), v.size()));
+
+                return v;
+            }
+
+            /**
+             * Encodes data and returns the result.
+             */
+            virtual std::vector<char> encode(const char *input, size_t count) const = 0;
 
             /**
-             * Encodes data from the stream and returns the result.
+             * Encodes data and returns the result.
              */
-            virtual std::vector<char> encode(std::vector<char> input) const = 0;
+            std::vector<char> encode(const std::vector<char> &input) const
+            {
+                return encode(input.data(), input.size());
+            }
 
             /**
              * Returns the logical, decoded size of the chunk.
@@ -84,14 +184,27 @@ namespace Casc
             virtual void reset() = 0;
 
             /**
-             * Checks the data against the MD5 checksum.
+             * Checks the encoded chunk against its checksum when it is first decoded,
+             * rather than up front, so a chunk that is never decoded by this handler,
+             * such as one found in the block cache, is never hashed. The key names
+             * the file in the exception thrown if they don't match.
+             */
+            void verifyOnDecode(const IndexKey &file)
+            {
+                this->unverified = true;
+                this->file = file;
+            }
+
+            /**
+             * Checks the encoded data against the MD5 checksum.
              */
             bool validate()
             {
-                auto data = this->source->get(1, SIZE_MAX);
-                auto hash = Hex(md5(data));
+                auto size = source->upper_bound - source->lower_bound;
+                auto view = source->view(0, size);
+                auto data = view != nullptr ? std::vector<char>() : source->get(0, size);
 
-                return hash == chunk.checksum;
+                return digest(view != nullptr ? view : data.data(), size) == chunk.checksum;
             }
         };
     }
@@ -100,3 +213,4 @@ namespace Casc
 #include "Impl/NoneHandler.hpp"
 #include "Impl/ZlibHandler.hpp"
 #include "Impl/CryptHandler.hpp"
+#include "Impl/CachedHandler.hpp"
@@ -0,0 +1,151 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "../BlockCache.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        namespace Impl
+        {
+            /**
+             * Cached handler. This wraps another handler and keeps the whole decoded chunk
+             * in a block cache, so other streams reading the same chunk don't decode it again.
+             */
+            class CachedHandler : public Handler
+            {
+                // The handler that does the decoding.
+                std::shared_ptr<Handler> inner;
+
+                // The cache shared with other streams.
+                std::shared_ptr<BlockCache> cache;
+
+                // The key of the file the chunk belongs to.
+                IndexKey key;
+
+                // The index of the chunk in the file.
+                size_t index;
+
+                // The block last read, kept alive until the handler is reset.
+                BlockCache::block_type block;
+
+                /**
+                 * Gets the decoded chunk from the cache, decoding and adding it if needed.
+                 */
+                BlockCache::block_type load()
+                {
+                    if (block != nullptr)
+                    {
+                        return block;
+                    }
+
+                    if (auto cached = cache->find(key, index))
+                    {
+                        return cached;
+                    }
+
+                    auto decoded = std::make_shared<std::vector<char>>(inner->logicalSize());
+                    decoded->resize(inner->decode(0, decoded->data(), decoded->size()));
+                    inner->reset();
+
+                    cache->insert(key, index, decoded);
+
+                    return decoded;
+                }
+
+            public:
+                EncodingMode mode() const override
+                {
+                    return inner->mode();
+                }
+
+                size_t decode(size_t offset, char *dest, size_t count) override
+                {
+                    if (inner->logicalSize() > cache->capacity())
+                    {
+                        return inner->decode(offset, dest, count);
+                    }
+
+                    block = load();
+
+                    if (offset >= block->size())
+                    {
+                        return 0;
+                    }
+
+                    count = std::min(count, block->size() - offset);
+                    std::memcpy(dest, block->data() + offset, count);
+
+                    return count;
+                }
+
+                const char *view(size_t offset, size_t count) override
+                {
+                    if (inner->logicalSize() > cache->capacity())
+                    {
+                        return inner->view(offset, count);
+                    }
+
+                    block = load();
+
+                    if (offset > block->size() || count > block->size() - offset)
+                    {
+                        return nullptr;
+                    }
+
+                    return block->data() + offset;
+                }
+
+                std::vector<char> encode(const char *input, size_t count) const override
+                {
+                    return inner->encode(input, count);
+                }
+
+                using Handler::decode;
+                using Handler::encode;
+
+                size_t logicalSize() override
+                {
+                    return inner->logicalSize();
+                }
+
+                void reset() override
+                {
+                    block = nullptr;
+                    inner->reset();
+                }
+
+                CachedHandler(std::shared_ptr<Handler> inner, std::shared_ptr<DataSource> source,
+                    std::shared_ptr<BlockCache> cache, const IndexKey &key, size_t index) :
+                    Handler(inner->chunk, source), inner(inner), cache(cache), key(key), index(index)
+                {
+
+                }
+            };
+        }
+    }
+}
\ No newline at end of file
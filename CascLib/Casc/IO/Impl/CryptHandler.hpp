@@ -17,6 +17,16 @@
 * along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+
+#include "../../Exceptions.hpp"
+#include "../../Crypto/KeyStore.hpp"
+#include "../../Crypto/Salsa20.hpp"
+#include "DecryptedSource.hpp"
+
 namespace Casc
 {
     namespace IO
@@ -24,44 +34,241 @@ namespace Casc
         namespace Impl
         {
             /**
-             * TODO: Needs implementation.
+             * Encrypted handler. The chunk holds the name of its key, an IV and the
+             * cipher, followed by an encrypted chunk of another mode, usually zlib.
+             * That chunk is read through a decrypting source by its own handler,
+             * so it is never held decrypted in full.
+             *
+             * Only Salsa20 is supported. ARC4 is listed by the format, but no
+             * known container uses it.
              */
             class CryptHandler : public Handler
             {
-			public:
-				EncodingMode mode() const override
-				{
-					return EncodingMode::Crypt;
-				}
+                // The cipher byte for Salsa20.
+                static const char Salsa20Cipher = 'S';
+
+                // The cipher byte for ARC4.
+                static const char ARC4Cipher = 'A';
+
+                // The handler for the decrypted chunk.
+                std::shared_ptr<Handler> handler;
+
+                // The keys the chunk was decrypted with.
+                const Crypto::KeyStore *keys = nullptr;
+
+                // The index of the chunk in the file, mixed into the IV.
+                size_t index = 0;
+
+                /**
+                 * Checks the encrypted chunk, once. If it had to be read into memory
+                 * for that, the decrypted chunk is read from there from then on.
+                 */
+                void verifyEncrypted()
+                {
+                    if (verify())
+                    {
+                        handler = createHandler(chunk, decrypt(source, keys, index));
+                    }
+                }
+
+                /**
+                 * Reads the encryption header and returns a source that decrypts the
+                 * rest of the chunk. The IV is combined with the index of the chunk.
+                 */
+                static std::shared_ptr<DataSource> decrypt(std::shared_ptr<DataSource> source,
+                    const Crypto::KeyStore *keys, size_t index)
+                {
+                    auto size = source->upper_bound - source->lower_bound;
+                    auto header = source->get(0, 32);
+
+                    auto at = [&header](size_t offset)
+                    {
+                        if (offset >= header.size())
+                        {
+                            throw Exceptions::IOException("Unexpected end of encrypted chunk.");
+                        }
+
+                        return static_cast<uint8_t>(header[offset]);
+                    };
+
+                    // The mode byte, then the key name.
+                    auto nameSize = at(1);
+
+                    if (nameSize != 8)
+                    {
+                        throw Exceptions::IOException("Invalid key name size in encrypted chunk.");
+                    }
+
+                    // The IV, then the cipher.
+                    auto ivSize = at(2 + nameSize);
+                    auto name = Endian::read<EndianType::Little, uint32_t>(header.data() + 2) |
+                        uint64_t(Endian::read<EndianType::Little, uint32_t>(header.data() + 6)) << 32;
+
+                    if (ivSize > 8)
+                    {
+                        throw Exceptions::IOException("Invalid IV size in encrypted chunk.");
+                    }
+
+                    uint8_t nonce[8] = {};
+
+                    for (auto i = 0U; i < ivSize; ++i)
+                    {
+                        nonce[i] = at(3 + nameSize + i);
+                    }
+
+                    for (auto i = 0U; i < 4; ++i)
+                    {
+                        nonce[i] ^= static_cast<uint8_t>(index >> (i * 8));
+                    }
+
+                    auto cipher = static_cast<char>(at(3 + nameSize + ivSize));
+                    auto offset = size_t(4 + nameSize + ivSize);
+
+                    if (cipher == ARC4Cipher)
+                    {
+                        throw Exceptions::IOException("ARC4 encrypted chunks are not supported.");
+                    }
+
+                    if (cipher != Salsa20Cipher)
+                    {
+                        throw Exceptions::IOException("Unknown cipher in encrypted chunk.");
+                    }
+
+                    auto key = keys != nullptr ? keys->find(name) : nullptr;
+
+                    if (key == nullptr)
+                    {
+                        throw Exceptions::EncryptionKeyDoesNotExistException(name);
+                    }
+
+                    if (offset >= size)
+                    {
+                        throw Exceptions::IOException("Unexpected end of encrypted chunk.");
+                    }
+
+                    return std::make_shared<DecryptedSource>(source->slice(offset, size - offset), Crypto::Salsa20(*key, nonce));
+                }
+
+                /**
+                 * Reads the mode of a decrypted chunk.
+                 */
+                static EncodingMode modeOf(std::shared_ptr<DataSource> source)
+                {
+                    char mode;
+
+                    if (source->read(0, &mode, 1) != 1)
+                    {
+                        throw Exceptions::IOException("Unexpected end of encrypted chunk.");
+                    }
+
+                    return (EncodingMode)mode;
+                }
+
+                /**
+                 * Creates the handler for a decrypted chunk listed in a block table.
+                 */
+                static std::shared_ptr<Handler> createHandler(Chunk chunk, std::shared_ptr<DataSource> source)
+                {
+                    chunk.size = source->upper_bound - source->lower_bound;
+
+                    switch (modeOf(source))
+                    {
+                    case EncodingMode::None:
+                        return std::make_shared<NoneHandler>(chunk, source);
+
+                    case EncodingMode::Zlib:
+                        return std::make_shared<ZlibHandler>(chunk, source);
+
+                    default:
+                        throw Exceptions::InvalidEncodingModeException(modeOf(source));
+                    }
+                }
+
+                /**
+                 * Creates the handler for a decrypted chunk without a block table.
+                 */
+                static std::shared_ptr<Handler> createHandler(std::shared_ptr<DataSource> source)
+                {
+                    switch (modeOf(source))
+                    {
+                    case EncodingMode::None:
+                        return std::make_shared<NoneHandler>(source);
+
+                    case EncodingMode::Zlib:
+                        return std::make_shared<ZlibHandler>(source);
+
+                    default:
+                        throw Exceptions::InvalidEncodingModeException(modeOf(source));
+                    }
+                }
+
+                /**
+                 * Constructor. Takes the handler for the decrypted chunk.
+                 */
+                CryptHandler(std::shared_ptr<Handler> handler, std::shared_ptr<DataSource> source)
+                    : Handler(handler->chunk, source), handler(handler)
+                {
+
+                }
+
+            public:
+                EncodingMode mode() const override
+                {
+                    return EncodingMode::Crypt;
+                }
+
+                size_t decode(size_t offset, char *dest, size_t count) override
+                {
+                    verifyEncrypted();
+
+                    return handler->decode(offset, dest, count);
+                }
+
+                const char *view(size_t offset, size_t count) override
+                {
+                    verifyEncrypted();
 
-				std::vector<char> decode(size_t offset, size_t count) override
-				{
-					return std::vector<char>();
-				}
+                    return handler->view(offset, count);
+                }
 
-				std::vector<char> encode(std::vector<char> input) const override
-				{
-					return std::vector<char>();
-				}
+                std::vector<char> encode(const char *input, size_t count) const override
+                {
+                    throw Exceptions::IOException("Encrypting chunks is not supported.");
+                }
 
-				size_t logicalSize() override
-				{
-					return 0;
-				}
+                using Handler::decode;
+                using Handler::encode;
 
-				void reset() override
-				{
+                size_t logicalSize() override
+                {
+                    return handler->logicalSize();
+                }
 
-				}
+                void reset() override
+                {
+                    handler->reset();
+                }
 
-				CryptHandler(std::shared_ptr<DataSource> source) :
-					Handler(Chunk(), source)
-				{
+                /**
+                 * Constructor. For a chunk listed in a block table, at the given index.
+                 */
+                CryptHandler(Chunk chunk, std::shared_ptr<DataSource> source,
+                    const Crypto::KeyStore *keys, size_t index)
+                    : Handler(chunk, source), handler(createHandler(chunk, decrypt(source, keys, index))),
+                    keys(keys), index(index)
+                {
 
-				}
+                }
 
-				using Handler::Handler;
-			};
+                /**
+                 * Constructor. For the only chunk of a file without a block table.
+                 */
+                CryptHandler(std::shared_ptr<DataSource> source, const Crypto::KeyStore *keys)
+                    : CryptHandler(createHandler(decrypt(source, keys, 0)), source)
+                {
+                    this->keys = keys;
+                }
+            };
         }
     }
-}
+}
\ No newline at end of file
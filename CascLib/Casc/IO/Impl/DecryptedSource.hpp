@@ -0,0 +1,89 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <memory>
+
+#include "../DataSource.hpp"
+#include "../../Crypto/Salsa20.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        namespace Impl
+        {
+            /**
+             * A source that decrypts an encrypted source as it is read. Data is
+             * decrypted straight into the reader's buffer, a read at a time.
+             */
+            class DecryptedSource : public DataSource
+            {
+                // The encrypted data.
+                std::shared_ptr<DataSource> source;
+
+                // The cipher the data is encrypted with.
+                Crypto::Salsa20 cipher;
+
+                // The offset in the key stream of the first byte of the source.
+                size_t start;
+
+            public:
+                /**
+                 * Constructor.
+                 */
+                DecryptedSource(std::shared_ptr<DataSource> source, const Crypto::Salsa20 &cipher, size_t start = 0)
+                    : DataSource(source->type, { 0, source->upper_bound - source->lower_bound }),
+                    source(source), cipher(cipher), start(start)
+                { }
+
+                /**
+                 * Reads and decrypts a chunk of data.
+                 */
+                size_t read(size_t offset, char *dest, size_t count) override
+                {
+                    auto n = source->read(offset, dest, count);
+
+                    cipher.apply(start + offset, dest, n);
+
+                    return n;
+                }
+
+                using DataSource::read;
+
+                /**
+                 * Starts reading a range of the encrypted data from disk.
+                 */
+                void willNeed(size_t offset, size_t count) const override
+                {
+                    source->willNeed(offset, count);
+                }
+
+                /**
+                 * Creates a source for a part of this source.
+                 */
+                std::shared_ptr<DataSource> slice(size_t offset, size_t count) const override
+                {
+                    return std::make_shared<DecryptedSource>(source->slice(offset, count), cipher, start + offset);
+                }
+            };
+        }
+    }
+}
\ No newline at end of file
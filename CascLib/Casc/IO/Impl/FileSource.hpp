@@ -0,0 +1,134 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../DataSource.hpp"
+#include "../PositionalFile.hpp"
+#include "../../Exceptions.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        namespace Impl
+        {
+            /**
+             * A source for data read from a file by offset. There is no shared
+             * file position, so the source and its slices can be read from
+             * several threads without locking.
+             */
+            class FileSource : public DataSource
+            {
+                // The file, shared with the slices of the source.
+                std::shared_ptr<PositionalFile> file;
+
+            public:
+                /**
+                 * Constructor.
+                 */
+                FileSource(std::shared_ptr<PositionalFile> file) :
+                    FileSource(file, { 0, file->size() })
+                { }
+
+                /**
+                 * Constructor.
+                 */
+                FileSource(std::shared_ptr<PositionalFile> file, std::pair<size_t, size_t> bounds) :
+                    DataSource(DataSourceType::File, bounds), file(file)
+                {
+                    if (bounds.first > bounds.second || bounds.second > file->size())
+                    {
+                        throw Exceptions::IOException("Invalid bounds.");
+                    }
+                }
+
+                /**
+                 * Copies a chunk of data.
+                 */
+                size_t read(size_t offset, char *dest, size_t count) override
+                {
+                    if (offset >= (upper_bound - lower_bound))
+                    {
+                        throw Exceptions::IOException("Invalid offset");
+                    }
+
+                    return file->read(lower_bound + offset, dest, std::min(count, upper_bound - lower_bound - offset));
+                }
+
+                /**
+                 * Reads a contiguous range into several buffers with one call.
+                 */
+                size_t read(size_t offset, const std::vector<std::pair<char*, size_t>> &buffers) override
+                {
+                    if (offset >= (upper_bound - lower_bound))
+                    {
+                        throw Exceptions::IOException("Invalid offset");
+                    }
+
+                    // Stop at the upper bound.
+                    auto available = upper_bound - lower_bound - offset;
+                    std::vector<std::pair<char*, size_t>> bounded;
+
+                    for (auto &buffer : buffers)
+                    {
+                        if (available == 0)
+                        {
+                            break;
+                        }
+
+                        bounded.emplace_back(buffer.first, std::min(buffer.second, available));
+                        available -= bounded.back().second;
+                    }
+
+                    return file->read(lower_bound + offset, bounded);
+                }
+
+                /**
+                 * Starts reading a range of the file from disk.
+                 */
+                void willNeed(size_t offset, size_t count) const override
+                {
+                    if (offset < upper_bound - lower_bound)
+                    {
+                        file->willNeed(lower_bound + offset, std::min(count, upper_bound - lower_bound - offset));
+                    }
+                }
+
+                using DataSource::read;
+
+                /**
+                 * Creates a source for a part of this source.
+                 */
+                std::shared_ptr<DataSource> slice(size_t offset, size_t count) const override
+                {
+                    auto begin = std::min(lower_bound + offset, upper_bound);
+                    auto end = upper_bound - begin > count ? begin + count : upper_bound;
+
+                    return std::make_shared<FileSource>(file, std::make_pair(begin, end));
+                }
+            };
+        }
+    }
+}
\ No newline at end of file
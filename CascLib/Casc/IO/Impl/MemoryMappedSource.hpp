@@ -19,7 +19,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+
 #include "../DataSource.hpp"
+#include "../MappedFile.hpp"
+#include "../../Exceptions.hpp"
 
 namespace Casc
 {
@@ -28,32 +33,125 @@ namespace Casc
         namespace Impl
         {
             /**
-             * A source for data.
+             * A source for data held in memory,
+             * either in an owned buffer or in a mapped file.
              */
             class MemoryMappedSource : public DataSource
             {
-                std::vector<char> buf;
+                // Keeps the memory alive while the source is in use.
+                std::shared_ptr<const void> owner;
+
+                // The start of the memory, the lower bound is relative to this.
+                const char *data;
+
+                // The mapped file the memory belongs to, if any.
+                const MappedFile *mapping = nullptr;
 
             public:
                 /**
                  * Constructor.
                  */
                 MemoryMappedSource(std::vector<char> bytes) :
-                    DataSource(DataSourceType::MemoryMapped, { 0, bytes.size() }), buf(bytes)
+                    MemoryMappedSource(std::make_shared<std::vector<char>>(std::move(bytes)))
                 { }
 
                 /**
-                 * Gets a chunk of data.
+                 * Constructor.
+                 */
+                MemoryMappedSource(std::shared_ptr<std::vector<char>> bytes) :
+                    DataSource(DataSourceType::MemoryMapped, { 0, bytes->size() }),
+                    owner(bytes), data(bytes->data())
+                { }
+
+                /**
+                 * Constructor.
+                 */
+                MemoryMappedSource(std::shared_ptr<MappedFile> file) :
+                    MemoryMappedSource(file, { 0, file->size() })
+                { }
+
+                /**
+                 * Constructor.
+                 */
+                MemoryMappedSource(std::shared_ptr<const void> owner, const char *data, std::pair<size_t, size_t> bounds) :
+                    DataSource(DataSourceType::MemoryMapped, bounds), owner(owner), data(data)
+                { }
+
+                /**
+                 * Constructor.
+                 */
+                MemoryMappedSource(std::shared_ptr<MappedFile> file, std::pair<size_t, size_t> bounds) :
+                    MemoryMappedSource(file, file->data(), bounds)
+                {
+                    mapping = file.get();
+
+                    if (bounds.first > bounds.second || bounds.second > file->size())
+                    {
+                        throw Exceptions::IOException("Invalid bounds.");
+                    }
+                }
+
+                /**
+                 * Copies a chunk of data.
+                 */
+                size_t read(size_t offset, char *dest, size_t count) override
+                {
+                    if (offset >= (upper_bound - lower_bound))
+                    {
+                        throw Exceptions::IOException("Invalid offset");
+                    }
+
+                    auto available = upper_bound - lower_bound - offset;
+
+                    if (count > available)
+                    {
+                        count = available;
+                    }
+
+                    std::memcpy(dest, data + lower_bound + offset, count);
+
+                    return count;
+                }
+
+                /**
+                 * Points directly at the memory.
+                 */
+                const char *view(size_t offset, size_t count) const override
+                {
+                    if (offset > (upper_bound - lower_bound) || count > (upper_bound - lower_bound - offset))
+                    {
+                        return nullptr;
+                    }
+
+                    return data + lower_bound + offset;
+                }
+
+                /**
+                 * Starts reading a range of a mapped file from disk.
+                 */
+                void willNeed(size_t offset, size_t count) const override
+                {
+                    if (mapping != nullptr && offset < upper_bound - lower_bound)
+                    {
+                        mapping->willNeed(lower_bound + offset, std::min(count, upper_bound - lower_bound - offset));
+                    }
+                }
+
+                using DataSource::read;
+
+                /**
+                 * Creates a source for a part of this source.
                  */
-                std::vector<char> get(size_t offset, size_t count) override
+                std::shared_ptr<DataSource> slice(size_t offset, size_t count) const override
                 {
-                    auto begin = buf.begin() + offset;
-                    auto end = size_t(buf.end() - begin) > count ? begin + count : buf.end();
+                    auto begin = std::min(lower_bound + offset, upper_bound);
+                    auto end = upper_bound - begin > count ? begin + count : upper_bound;
 
-                    return std::vector<char>(begin, end);
-                };
+                    auto source = std::make_shared<MemoryMappedSource>(owner, data, std::make_pair(begin, end));
+                    source->mapping = mapping;
 
-                using DataSource::DataSource;
+                    return source;
+                }
             };
         }
     }
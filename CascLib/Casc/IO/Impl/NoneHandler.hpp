@@ -45,20 +45,32 @@ namespace Casc
                     return EncodingMode::None;
                 }
 
-                std::vector<char> decode(size_t offset, size_t count) override
+                size_t decode(size_t offset, char *dest, size_t count) override
                 {
-                    return source->get(offset + 1, count);
+                    verify();
+
+                    return source->read(offset + 1, dest, count);
+                }
+
+                const char *view(size_t offset, size_t count) override
+                {
+                    verify();
+
+                    return source->view(offset + 1, count);
                 }
 
-                std::vector<char> encode(std::vector<char> input) const override
+                std::vector<char> encode(const char *input, size_t count) const override
                 {
-                    std::vector<char> v(input.size() + 1, '\0');
-                    std::memcpy(v.data() + 1, input.data(), input.size());
+                    std::vector<char> v(count + 1, '\0');
+                    std::memcpy(v.data() + 1, input, count);
                     v[0] = mode();
 
-                    return std::move(v);
+                    return v;
                 }
 
+                using Handler::decode;
+                using Handler::encode;
+
                 size_t logicalSize() override
                 {
                     return chunk.size - 1;
@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <memory>
+#include <mutex>
+
 #include "../DataSource.hpp"
 #include "../../Exceptions.hpp"
 
@@ -29,26 +32,36 @@ namespace Casc
         namespace Impl
         {
             /**
-             * A source for data.
+             * A source for data read from a stream. The stream is shared with the
+             * slices of the source, so the seek and read of each call are done
+             * under a lock shared by all of them.
              */
             class StreamSource : public DataSource
             {
                 std::shared_ptr<std::istream> stream;
+                std::shared_ptr<std::mutex> mutex;
                 size_t begin;
                 size_t end;
 
+                /**
+                 * Constructor for a slice sharing the lock of its parent.
+                 */
+                StreamSource(std::shared_ptr<std::istream> stream, std::shared_ptr<std::mutex> mutex,
+                    std::pair<size_t, size_t> bounds) :
+                    DataSource(DataSourceType::Stream, bounds), stream(stream), mutex(mutex),
+                    begin(bounds.first), end(bounds.second) { }
+
             public:
                 /**
                  * Constructor.
                  */
                 StreamSource(std::shared_ptr<std::istream> stream, std::pair<size_t, size_t> bounds) :
-                    DataSource(DataSourceType::Stream, bounds), stream(stream),
-                    begin(bounds.first), end(bounds.second) { }
+                    StreamSource(stream, std::make_shared<std::mutex>(), bounds) { }
 
                 /**
-                 * Gets a chunk of data.
+                 * Copies a chunk of data.
                  */
-                std::vector<char> get(size_t offset, size_t count) override
+                size_t read(size_t offset, char *dest, size_t count) override
                 {
                     if (offset >= (end - begin))
                     {
@@ -62,14 +75,27 @@ namespace Casc
                         count = available;
                     }
 
-                    std::vector<char> v(count, '\0');
+                    std::lock_guard<std::mutex> lock(*mutex);
+
+                    stream->clear();
                     stream->seekg(begin + offset, std::ios_base::beg);
-                    stream->read(v.data(), count);
+                    stream->read(dest, count);
 
-                    return v;
+                    return static_cast<size_t>(stream->gcount());
                 }
 
-                using DataSource::DataSource;
+                using DataSource::read;
+
+                /**
+                 * Creates a source for a part of this source.
+                 */
+                std::shared_ptr<DataSource> slice(size_t offset, size_t count) const override
+                {
+                    auto first = std::min(begin + offset, end);
+                    auto last = end - first > count ? first + count : end;
+
+                    return std::shared_ptr<DataSource>(new StreamSource(stream, mutex, std::make_pair(first, last)));
+                }
             };
         }
     }
@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <memory>
 
@@ -32,41 +34,138 @@ namespace Casc
         {
             /**
              * Zlib handler. This decompresses a zlib compressed chunk and extracts the data.
+             * Output is inflated straight into the caller's buffer. The inflate state is kept
+             * between calls, so sequential reads continue where the last one stopped;
+             * reading backwards starts over from the beginning of the chunk.
              */
             class ZlibHandler : public Handler
             {
                 const int CompressionLevel = 9;
                 const int WindowBits = 15;
 
-                std::vector<char> decoded;
+                // The compressed data, when the source can't be viewed in place.
+                std::vector<char> input;
 
-                Chunk constructChunk(std::shared_ptr<DataSource> source)
+                // The inflate state.
+                std::unique_ptr<ZInflateStream> stream;
+
+                // The number of bytes inflated so far.
+                size_t produced = 0;
+
+                /**
+                 * Points at the compressed data, reading it from the source if needed.
+                 */
+                const ZStreamBase::char_t *compressed(size_t &size)
+                {
+                    size = source->upper_bound - source->lower_bound - 1;
+
+                    if (auto view = source->view(1, size))
+                    {
+                        return reinterpret_cast<const ZStreamBase::char_t*>(view);
+                    }
+
+                    if (input.size() != size)
+                    {
+                        input = source->get(1, size);
+                    }
+
+                    return reinterpret_cast<const ZStreamBase::char_t*>(input.data());
+                }
+
+                /**
+                 * Starts inflating from the beginning of the chunk.
+                 */
+                void restart()
+                {
+                    verify();
+
+                    size_t size;
+                    auto data = compressed(size);
+
+                    if (stream == nullptr)
+                    {
+                        stream = std::make_unique<ZInflateStream>(data, size);
+                    }
+                    else
+                    {
+                        stream->reset(data, size);
+                    }
+
+                    produced = 0;
+                }
+
+                /**
+                 * Inflates up to count bytes into dest and returns the number of bytes written.
+                 */
+                size_t inflate(char *dest, size_t count)
                 {
-                    auto decoded = decode(source);
-                    return{ 0, decoded.size(), 0, source->upper_bound - source->lower_bound };
+                    size_t written = 0;
+
+                    while (written < count && !stream->isStreamEnd())
+                    {
+                        auto n = static_cast<size_t>(std::min<uint64_t>(count - written, UINT32_MAX));
+
+                        stream->read(reinterpret_cast<ZStreamBase::char_t*>(dest + written), n);
+
+                        auto done = n - stream->availOut();
+
+                        if (done == 0 && !stream->isStreamEnd())
+                        {
+                            throw Exceptions::IOException("Truncated zlib stream.");
+                        }
+
+                        written += done;
+                    }
+
+                    produced += written;
+
+                    return written;
                 }
 
-                std::vector<char> decode(std::shared_ptr<DataSource> source)
+                /**
+                 * Inflates and discards data until the stream is at the offset.
+                 */
+                void skip(size_t offset)
                 {
-                    auto in = source->get(1, SIZE_MAX);
+                    if (stream == nullptr || offset < produced)
+                    {
+                        restart();
+                    }
 
-                    std::vector<char> decoded;
+                    char scratch[ChunkSize];
 
-                    if (decoded.size() == 0)
+                    while (produced < offset && !stream->isStreamEnd())
                     {
-                        ZStreamBase::char_t* out = nullptr;
-                        size_t avail_out = 0;
+                        inflate(scratch, std::min(offset - produced, ChunkSize));
+                    }
+                }
+
+                static Chunk constructChunk(std::shared_ptr<DataSource> source)
+                {
+                    // Without a block table the decoded size is only known after inflating.
+                    auto size = source->upper_bound - source->lower_bound - 1;
+                    auto view = source->view(1, size);
+                    auto data = view != nullptr ? std::vector<char>() : source->get(1, size);
 
-                        ZInflateStream(reinterpret_cast<unsigned char*>(
-                            in.data()), in.size()).readAll(&out, avail_out);
+                    ZInflateStream zstream(reinterpret_cast<const ZStreamBase::char_t*>(
+                        view != nullptr ? view : data.data()), size);
+
+                    ZStreamBase::char_t scratch[ChunkSize];
+                    size_t total = 0;
+
+                    while (!zstream.isStreamEnd())
+                    {
+                        zstream.read(scratch, ChunkSize);
 
-                        decoded.resize(avail_out);
-                        std::memcpy(decoded.data(), out, avail_out);
+                        if (zstream.availOut() == ChunkSize && !zstream.isStreamEnd())
+                        {
+                            throw Exceptions::IOException("Truncated zlib stream.");
+                        }
 
-                        delete out;
+                        total += ChunkSize - zstream.availOut();
                     }
 
-                    return decoded;
+                    return{ 0, total, 0, source->upper_bound - source->lower_bound };
                 }
 
             public:
@@ -75,59 +174,56 @@ namespace Casc
                     return EncodingMode::Zlib;
                 }
 
-                std::vector<char> decode(size_t offset, size_t count) override
+                size_t decode(size_t offset, char *dest, size_t count) override
                 {
-                    if (decoded.size() == 0)
+                    if (offset >= logicalSize())
                     {
-                        decoded = decode(source);
+                        throw Exceptions::IOException("Invalid offset.");
                     }
 
-                    if (offset >= decoded.size())
+                    skip(offset);
+
+                    if (produced != offset)
                     {
-                        throw Exceptions::IOException("Invalid offset.");
+                        return 0;
                     }
 
-                    auto begin = decoded.begin() + offset;
-                    auto end = size_t(decoded.end() - begin) < count ? decoded.end() : begin + count;
-
-                    return { begin, end };
+                    return inflate(dest, std::min(count, logicalSize() - offset));
                 }
 
-                std::vector<char> encode(std::vector<char> input) const override
+                std::vector<char> encode(const char *input, size_t count) const override
                 {
                     ZDeflateStream zstream(this->CompressionLevel);
-                    zstream.write(reinterpret_cast<ZStreamBase::char_t*>(input.data()), input.size());
+                    zstream.write(reinterpret_cast<const ZStreamBase::char_t*>(input), count);
+                    zstream.flush();
 
-                    char* buf;
+                    ZStreamBase::char_t *buf;
                     size_t bufSize;
 
-                    zstream.readAll(reinterpret_cast<ZStreamBase::char_t**>(&buf), bufSize);
+                    zstream.readAll(&buf, bufSize);
 
                     std::vector<char> v(bufSize + 1, '\0');
                     std::memcpy(v.data() + 1, buf, bufSize);
                     v[0] = mode();
 
-                    return std::move(v);
+                    delete[] buf;
+
+                    return v;
                 }
 
+                using Handler::decode;
+                using Handler::encode;
+
                 size_t logicalSize() override
                 {
-                    if (chunk.end == chunk.begin)
-                    {
-                        if (decoded.size() == 0)
-                        {
-                            return decode(0, source->upper_bound - source->lower_bound).size();
-                        }
-
-                        return decoded.size();
-                    }
-
                     return chunk.end - chunk.begin;
                 }
 
                 void reset() override
                 {
-                    decoded.clear();
+                    stream = nullptr;
+                    input.clear();
+                    produced = 0;
                 }
 
                 ZlibHandler(std::shared_ptr<DataSource> source) :
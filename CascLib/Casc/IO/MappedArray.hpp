@@ -0,0 +1,180 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        /**
+         * A read-only array that either owns its elements or views them
+         * inside a mapped file, such as a snapshot.
+         */
+        template <typename T>
+        class MappedArray
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                "Only trivially copyable elements can be mapped.");
+
+        private:
+            // The elements, when the array owns them.
+            std::vector<T> owned;
+
+            // The mapped file, when the elements are inside it.
+            std::shared_ptr<const MappedFile> file;
+
+            // The first element.
+            const T *data_ = nullptr;
+
+            // The number of elements.
+            size_t size_ = 0;
+
+        public:
+            typedef T value_type;
+            typedef const T *const_iterator;
+
+            /**
+             * Default constructor. The array is empty.
+             */
+            MappedArray()
+            {
+            }
+
+            /**
+             * Constructor. Takes ownership of the elements.
+             */
+            MappedArray(std::vector<T> &&values)
+                : owned(std::move(values)), data_(owned.data()), size_(owned.size())
+            {
+            }
+
+            /**
+             * Constructor. Views elements inside a mapped file.
+             */
+            MappedArray(std::shared_ptr<const MappedFile> file, const T *data, size_t size)
+                : file(file), data_(data), size_(size)
+            {
+            }
+
+            /**
+             * Copy constructor.
+             */
+            MappedArray(const MappedArray &other)
+                : owned(other.owned), file(other.file),
+                  data_(other.file != nullptr ? other.data_ : owned.data()), size_(other.size_)
+            {
+            }
+
+            /**
+             * Move constructor.
+             */
+            MappedArray(MappedArray &&other)
+                : owned(std::move(other.owned)), file(std::move(other.file)), data_(other.data_), size_(other.size_)
+            {
+                other.data_ = nullptr;
+                other.size_ = 0;
+            }
+
+            /**
+             * Copy operator.
+             */
+            MappedArray &operator= (const MappedArray &other)
+            {
+                return *this = MappedArray(other);
+            }
+
+            /**
+             * Move operator.
+             */
+            MappedArray &operator= (MappedArray &&other)
+            {
+                owned = std::move(other.owned);
+                file = std::move(other.file);
+                data_ = other.data_;
+                size_ = other.size_;
+
+                other.data_ = nullptr;
+                other.size_ = 0;
+
+                return *this;
+            }
+
+            /**
+             * Destructor.
+             */
+            virtual ~MappedArray() = default;
+
+            /**
+             * The first element.
+             */
+            const T *data() const
+            {
+                return data_;
+            }
+
+            /**
+             * The number of elements.
+             */
+            size_t size() const
+            {
+                return size_;
+            }
+
+            /**
+             * True when there are no elements.
+             */
+            bool empty() const
+            {
+                return size_ == 0;
+            }
+
+            /**
+             * An iterator to the first element.
+             */
+            const_iterator begin() const
+            {
+                return data_;
+            }
+
+            /**
+             * An iterator past the last element.
+             */
+            const_iterator end() const
+            {
+                return data_ + size_;
+            }
+
+            /**
+             * Gets an element.
+             */
+            const T &operator[](size_t i) const
+            {
+                return data_[i];
+            }
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../Exceptions.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        /**
+         * A read-only memory mapping of a whole file.
+         */
+        class MappedFile
+        {
+        private:
+#if defined(_WIN32)
+            // The file handle.
+            HANDLE file = INVALID_HANDLE_VALUE;
+
+            // The file mapping handle.
+            HANDLE mapping = nullptr;
+#else
+            // The file descriptor.
+            int fd = -1;
+#endif
+
+            // The start of the mapped view.
+            const char *data_ = nullptr;
+
+            // The size of the mapped view.
+            size_t size_ = 0;
+
+            /**
+             * Unmaps the view and closes the handles.
+             */
+            void close()
+            {
+#if defined(_WIN32)
+                if (data_ != nullptr)
+                {
+                    UnmapViewOfFile(data_);
+                }
+
+                if (mapping != nullptr)
+                {
+                    CloseHandle(mapping);
+                }
+
+                if (file != INVALID_HANDLE_VALUE)
+                {
+                    CloseHandle(file);
+                }
+#else
+                if (data_ != nullptr)
+                {
+                    munmap(const_cast<char*>(data_), size_);
+                }
+
+                if (fd != -1)
+                {
+                    ::close(fd);
+                }
+#endif
+                data_ = nullptr;
+                size_ = 0;
+            }
+
+        public:
+            /**
+             * Constructor. Maps the whole file at the given path.
+             */
+            MappedFile(const std::string &path)
+            {
+#if defined(_WIN32)
+                file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+                if (file == INVALID_HANDLE_VALUE)
+                {
+                    throw Exceptions::FileNotFoundException(path);
+                }
+
+                LARGE_INTEGER size;
+
+                if (!GetFileSizeEx(file, &size))
+                {
+                    close();
+                    throw Exceptions::IOException("Couldn't get the size of the file.");
+                }
+
+                size_ = static_cast<size_t>(size.QuadPart);
+
+                if (size_ > 0)
+                {
+                    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+                    if (mapping == nullptr)
+                    {
+                        close();
+                        throw Exceptions::IOException("Couldn't map the file.");
+                    }
+
+                    data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+                    if (data_ == nullptr)
+                    {
+                        close();
+                        throw Exceptions::IOException("Couldn't map the file.");
+                    }
+                }
+#else
+                fd = ::open(path.c_str(), O_RDONLY);
+
+                if (fd == -1)
+                {
+                    throw Exceptions::FileNotFoundException(path);
+                }
+
+                struct stat st;
+
+                if (fstat(fd, &st) != 0)
+                {
+                    close();
+                    throw Exceptions::IOException("Couldn't get the size of the file.");
+                }
+
+                if (st.st_size > 0)
+                {
+                    auto ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+                    if (ptr == MAP_FAILED)
+                    {
+                        close();
+                        throw Exceptions::IOException("Couldn't map the file.");
+                    }
+
+                    data_ = static_cast<const char*>(ptr);
+                    size_ = static_cast<size_t>(st.st_size);
+                }
+#endif
+            }
+
+            /**
+             * Copy constructor.
+             */
+            MappedFile(const MappedFile &) = delete;
+
+            /**
+             * Copy operator.
+             */
+            MappedFile &operator= (const MappedFile &) = delete;
+
+            /**
+             * Destructor.
+             */
+            virtual ~MappedFile()
+            {
+                close();
+            }
+
+            /**
+             * The start of the mapped data.
+             */
+            const char *data() const
+            {
+                return data_;
+            }
+
+            /**
+             * The size of the mapped data.
+             */
+            size_t size() const
+            {
+                return size_;
+            }
+
+            /**
+             * Asks the system to start reading a range of the file into memory.
+             */
+            void willNeed(size_t offset, size_t count) const
+            {
+#if !defined(_WIN32)
+                if (data_ == nullptr || offset >= size_)
+                {
+                    return;
+                }
+
+                auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                auto begin = offset - offset % page;
+                auto end = std::min(size_, offset + count);
+
+                madvise(const_cast<char*>(data_) + begin, end - begin, MADV_WILLNEED);
+#endif
+            }
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,300 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "../Exceptions.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        /**
+         * A read-only file read by offset, without a shared file position.
+         * Any number of threads can read from it at once.
+         */
+        class PositionalFile
+        {
+        private:
+#if defined(_WIN32)
+            // The file handle.
+            HANDLE file = INVALID_HANDLE_VALUE;
+#else
+            // The file descriptor.
+            int fd = -1;
+#endif
+
+            // The size of the file.
+            size_t size_ = 0;
+
+            /**
+             * Closes the handle.
+             */
+            void close()
+            {
+#if defined(_WIN32)
+                if (file != INVALID_HANDLE_VALUE)
+                {
+                    CloseHandle(file);
+                    file = INVALID_HANDLE_VALUE;
+                }
+#else
+                if (fd != -1)
+                {
+                    ::close(fd);
+                    fd = -1;
+                }
+#endif
+            }
+
+        public:
+            /**
+             * Constructor. Opens the file at the given path.
+             */
+            PositionalFile(const std::string &path)
+            {
+#if defined(_WIN32)
+                file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+                if (file == INVALID_HANDLE_VALUE)
+                {
+                    throw Exceptions::FileNotFoundException(path);
+                }
+
+                LARGE_INTEGER size;
+
+                if (!GetFileSizeEx(file, &size))
+                {
+                    close();
+                    throw Exceptions::IOException("Couldn't get the size of the file.");
+                }
+
+                size_ = static_cast<size_t>(size.QuadPart);
+#else
+                fd = ::open(path.c_str(), O_RDONLY);
+
+                if (fd == -1)
+                {
+                    throw Exceptions::FileNotFoundException(path);
+                }
+
+                struct stat st;
+
+                if (fstat(fd, &st) != 0)
+                {
+                    close();
+                    throw Exceptions::IOException("Couldn't get the size of the file.");
+                }
+
+                size_ = static_cast<size_t>(st.st_size);
+#endif
+            }
+
+            /**
+             * Copy constructor.
+             */
+            PositionalFile(const PositionalFile &) = delete;
+
+            /**
+             * Copy operator.
+             */
+            PositionalFile &operator= (const PositionalFile &) = delete;
+
+            /**
+             * Destructor.
+             */
+            virtual ~PositionalFile()
+            {
+                close();
+            }
+
+            /**
+             * The size of the file.
+             */
+            size_t size() const
+            {
+                return size_;
+            }
+
+            /**
+             * Asks the system to start reading a range of the file into the page cache.
+             */
+            void willNeed(size_t offset, size_t count) const
+            {
+#if !defined(_WIN32) && !defined(__APPLE__)
+                posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(count), POSIX_FADV_WILLNEED);
+#endif
+            }
+
+            /**
+             * Reads up to count bytes at an offset and returns the number of bytes read.
+             */
+            size_t read(size_t offset, char *dest, size_t count) const
+            {
+                size_t total = 0;
+
+                while (total < count)
+                {
+#if defined(_WIN32)
+                    OVERLAPPED overlapped = {};
+                    auto position = static_cast<uint64_t>(offset + total);
+                    overlapped.Offset = static_cast<DWORD>(position);
+                    overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+
+                    DWORD n = 0;
+                    auto requested = static_cast<DWORD>(std::min<size_t>(count - total, MAXDWORD));
+
+                    if (!ReadFile(file, dest + total, requested, &n, &overlapped))
+                    {
+                        if (GetLastError() == ERROR_HANDLE_EOF)
+                        {
+                            break;
+                        }
+
+                        throw Exceptions::IOException("Couldn't read from the file.");
+                    }
+#else
+                    auto n = ::pread(fd, dest + total, count - total, static_cast<off_t>(offset + total));
+
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+
+                        throw Exceptions::IOException("Couldn't read from the file.");
+                    }
+#endif
+                    if (n == 0)
+                    {
+                        break;
+                    }
+
+                    total += static_cast<size_t>(n);
+                }
+
+                return total;
+            }
+
+            /**
+             * Reads a contiguous range starting at an offset into several buffers,
+             * filling each before moving to the next, and returns the number of bytes read.
+             * On POSIX systems this is a single preadv call when the kernel allows it.
+             */
+            size_t read(size_t offset, const std::vector<std::pair<char*, size_t>> &buffers) const
+            {
+#if !defined(_WIN32)
+                if (buffers.size() > 1 && buffers.size() <= IOV_MAX)
+                {
+                    std::vector<iovec> vectors(buffers.size());
+                    size_t count = 0;
+
+                    for (auto i = 0U; i < buffers.size(); ++i)
+                    {
+                        vectors[i].iov_base = buffers[i].first;
+                        vectors[i].iov_len = buffers[i].second;
+                        count += buffers[i].second;
+                    }
+
+                    ssize_t n;
+
+                    do
+                    {
+                        n = ::preadv(fd, vectors.data(), static_cast<int>(vectors.size()), static_cast<off_t>(offset));
+                    } while (n < 0 && errno == EINTR);
+
+                    if (n < 0)
+                    {
+                        throw Exceptions::IOException("Couldn't read from the file.");
+                    }
+
+                    auto total = static_cast<size_t>(n);
+
+                    // Short reads are finished one buffer at a time.
+                    if (total < count)
+                    {
+                        size_t position = 0;
+
+                        for (auto &buffer : buffers)
+                        {
+                            auto end = position + buffer.second;
+
+                            if (total < end)
+                            {
+                                auto done = total - std::min(total, position);
+                                auto more = read(offset + position + done, buffer.first + done, buffer.second - done);
+
+                                total = position + done + more;
+
+                                if (done + more < buffer.second)
+                                {
+                                    break;
+                                }
+                            }
+
+                            position = end;
+                        }
+                    }
+
+                    return total;
+                }
+#endif
+                size_t total = 0;
+
+                for (auto &buffer : buffers)
+                {
+                    auto n = read(offset + total, buffer.first, buffer.second);
+                    total += n;
+
+                    if (n < buffer.second)
+                    {
+                        break;
+                    }
+                }
+
+                return total;
+            }
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,314 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+
+#include "../Exceptions.hpp"
+#include "../Crypto/Lookup3.hpp"
+#include "MappedArray.hpp"
+#include "MappedFile.hpp"
+
+namespace Casc
+{
+    namespace IO
+    {
+        /**
+         * The layout shared by snapshot writers and readers.
+         */
+        struct SnapshotFormat
+        {
+            // The file signature, "CSNP".
+            static const uint32_t Signature = 0x504E5343;
+
+            // Increased whenever the layout of a snapshot changes.
+            static const uint32_t Version = 5;
+
+            // The size of the signature, version and payload checksum.
+            static const size_t HeaderSize = 16U;
+
+            // Arrays start on a multiple of this many bytes, so they can be used in place.
+            static const size_t Alignment = 16U;
+
+            /**
+             * The checksum of the payload, everything after the header.
+             */
+            static uint64_t checksum(const char *data, size_t size)
+            {
+                auto hash = Crypto::lookup3(data, data + size);
+
+                return (uint64_t(hash.first) << 32) | hash.second;
+            }
+        };
+
+        /**
+         * Writes the parsed tables of a container to a snapshot file.
+         */
+        class SnapshotWriter
+        {
+        private:
+            // The path of the snapshot file.
+            std::string path;
+
+            // The snapshot file.
+            std::ofstream stream;
+
+            // The number of bytes written.
+            size_t offset = 0;
+
+            /**
+             * Writes raw bytes.
+             */
+            void put(const void *data, size_t count)
+            {
+                stream.write(static_cast<const char*>(data), count);
+                offset += count;
+            }
+
+        public:
+            /**
+             * Constructor. Creates or replaces the file at the given path.
+             */
+            SnapshotWriter(const std::string &path)
+                : path(path), stream(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc)
+            {
+                if (!stream)
+                {
+                    throw Exceptions::IOException("Couldn't create the snapshot.");
+                }
+
+                write(SnapshotFormat::Signature);
+                write(SnapshotFormat::Version);
+
+                // The checksum is filled in by close.
+                write(uint64_t(0));
+            }
+
+            /**
+             * Writes a value.
+             */
+            template <typename T>
+            void write(T value)
+            {
+                static_assert(std::is_trivially_copyable<T>::value,
+                    "Only trivially copyable values can be written.");
+
+                put(&value, sizeof(T));
+            }
+
+            /**
+             * Writes a string.
+             */
+            void write(const std::string &value)
+            {
+                write(static_cast<uint64_t>(value.size()));
+                put(value.data(), value.size());
+            }
+
+            /**
+             * Writes a map.
+             */
+            template <typename Key, typename Value>
+            void write(const std::map<Key, Value> &values)
+            {
+                write(static_cast<uint64_t>(values.size()));
+
+                for (auto &value : values)
+                {
+                    write(value.first);
+                    write(value.second);
+                }
+            }
+
+            /**
+             * Writes an array, aligned so that it can be mapped in place.
+             */
+            template <typename T>
+            void write(const T *data, size_t count)
+            {
+                static_assert(std::is_trivially_copyable<T>::value,
+                    "Only trivially copyable values can be written.");
+
+                write(static_cast<uint64_t>(count));
+                write(static_cast<uint32_t>(sizeof(T)));
+
+                static const char zeros[SnapshotFormat::Alignment] = {};
+                put(zeros, (SnapshotFormat::Alignment - offset % SnapshotFormat::Alignment) % SnapshotFormat::Alignment);
+                put(data, sizeof(T) * count);
+            }
+
+            /**
+             * Flushes the file, fills in the payload checksum, and throws if
+             * anything couldn't be written.
+             */
+            void close()
+            {
+                stream.close();
+
+                if (stream.fail())
+                {
+                    throw Exceptions::IOException("Couldn't write the snapshot.");
+                }
+
+                uint64_t checksum;
+
+                {
+                    MappedFile file(path);
+                    checksum = SnapshotFormat::checksum(file.data() + SnapshotFormat::HeaderSize,
+                        file.size() - SnapshotFormat::HeaderSize);
+                }
+
+                std::fstream header(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+                header.seekp(SnapshotFormat::HeaderSize - sizeof(checksum));
+                header.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+                header.close();
+
+                if (header.fail())
+                {
+                    throw Exceptions::IOException("Couldn't write the snapshot.");
+                }
+            }
+        };
+
+        /**
+         * Reads the tables written by a SnapshotWriter. The file is memory
+         * mapped, and the arrays it returns point into the mapping.
+         */
+        class SnapshotReader
+        {
+        private:
+            // The snapshot file.
+            std::shared_ptr<const MappedFile> file;
+
+            // The position of the next value.
+            size_t offset = 0;
+
+            /**
+             * Takes the next raw bytes.
+             */
+            const char *take(size_t count)
+            {
+                if (offset > file->size() || count > file->size() - offset)
+                {
+                    throw Exceptions::ParserException("Unexpected end of snapshot.");
+                }
+
+                auto data = file->data() + offset;
+                offset += count;
+
+                return data;
+            }
+
+        public:
+            /**
+             * Constructor. Maps the snapshot at the given path.
+             */
+            SnapshotReader(const std::string &path)
+                : file(std::make_shared<MappedFile>(path))
+            {
+                if (read<uint32_t>() != SnapshotFormat::Signature ||
+                    read<uint32_t>() != SnapshotFormat::Version)
+                {
+                    throw Exceptions::ParserException("The snapshot was written by a different version.");
+                }
+
+                if (read<uint64_t>() != SnapshotFormat::checksum(file->data() + SnapshotFormat::HeaderSize,
+                    file->size() - SnapshotFormat::HeaderSize))
+                {
+                    throw Exceptions::ParserException("The snapshot is corrupt.");
+                }
+            }
+
+            /**
+             * Reads a value.
+             */
+            template <typename T>
+            T read()
+            {
+                static_assert(std::is_trivially_copyable<T>::value,
+                    "Only trivially copyable values can be read.");
+
+                T value;
+                std::memcpy(&value, take(sizeof(T)), sizeof(T));
+
+                return value;
+            }
+
+            /**
+             * Reads a string.
+             */
+            std::string readString()
+            {
+                auto size = read<uint64_t>();
+                auto data = take(static_cast<size_t>(size));
+
+                return std::string(data, data + size);
+            }
+
+            /**
+             * Reads a map.
+             */
+            template <typename Key, typename Value>
+            std::map<Key, Value> readMap()
+            {
+                std::map<Key, Value> values;
+
+                for (auto i = read<uint64_t>(); i > 0; --i)
+                {
+                    auto key = read<Key>();
+                    values[key] = read<Value>();
+                }
+
+                return values;
+            }
+
+            /**
+             * Reads an array without copying it.
+             */
+            template <typename T>
+            MappedArray<T> readArray()
+            {
+                auto count = read<uint64_t>();
+
+                if (read<uint32_t>() != sizeof(T))
+                {
+                    throw Exceptions::ParserException("The snapshot was written with a different record layout.");
+                }
+
+                take((SnapshotFormat::Alignment - offset % SnapshotFormat::Alignment) % SnapshotFormat::Alignment);
+
+                if (count > (file->size() - offset) / sizeof(T))
+                {
+                    throw Exceptions::ParserException("Unexpected end of snapshot.");
+                }
+
+                auto data = reinterpret_cast<const T*>(take(sizeof(T) * static_cast<size_t>(count)));
+
+                return MappedArray<T>(file, data, static_cast<size_t>(count));
+            }
+        };
+    }
+}
\ No newline at end of file
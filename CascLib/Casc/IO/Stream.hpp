@@ -58,6 +58,20 @@ namespace Casc
                 open(filename, offset);
             }
 
+            /**
+             * Constructor.
+             */
+            Stream(std::shared_ptr<DataSource> file, size_t offset,
+                std::shared_ptr<ThreadPool> pool = nullptr,
+                std::shared_ptr<BlockCache> cache = nullptr, const IndexKey &key = IndexKey(),
+                Verification verification = Verification::None,
+                std::shared_ptr<const Crypto::KeyStore> keys = nullptr) :
+                buf(reinterpret_cast<Buffer*>(this->rdbuf())),
+                std::istream(new Buffer())
+            {
+                open(file, offset, pool, cache, key, verification, keys);
+            }
+
             /**
              * Move constructor.
              */
@@ -89,6 +103,43 @@ namespace Casc
                 open(filename.c_str(), offset);
             }
 
+            /**
+             * Opens a file in a data file that is already open.
+             */
+            void open(std::shared_ptr<DataSource> file, size_t offset,
+                std::shared_ptr<ThreadPool> pool = nullptr,
+                std::shared_ptr<BlockCache> cache = nullptr, const IndexKey &key = IndexKey(),
+                Verification verification = Verification::None,
+                std::shared_ptr<const Crypto::KeyStore> keys = nullptr)
+            {
+                buf->open(file, offset, pool, cache, key, verification, keys);
+            }
+
+            /**
+             * Decodes the whole file, using the thread pool if there is one.
+             */
+            std::vector<char> readAll()
+            {
+                return buf->readAll();
+            }
+
+            /**
+             * Decodes count bytes from an offset into dest and returns the
+             * number of bytes written. Doesn't move the read position.
+             */
+            size_t readRange(size_t offset, char *dest, size_t count)
+            {
+                return buf->readRange(offset, dest, count);
+            }
+
+            /**
+             * The decoded size of the file.
+             */
+            size_t size() const
+            {
+                return buf->size();
+            }
+
             /**
              * Closes the file.
              */
@@ -19,14 +19,26 @@
 
 #pragma once
 
+#include <algorithm>
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "../Common.hpp"
+#include "../ThreadPool.hpp"
+#include "../Crypto/KeyStore.hpp"
 
 #include "../Parsers/Binary/Reference.hpp"
+#include "BlockCache.hpp"
+#include "DataSource.hpp"
+#include "MappedFile.hpp"
+#include "PositionalFile.hpp"
 #include "Stream.hpp"
+#include "Verification.hpp"
 
 namespace Casc
 {
@@ -40,6 +52,41 @@ namespace Casc
             */
             std::string basePath;
 
+            /**
+            * Decodes large reads concurrently, if set.
+            */
+            std::shared_ptr<ThreadPool> pool;
+
+            /**
+            * Shares decoded chunks between streams, if set.
+            */
+            std::shared_ptr<BlockCache> cache;
+
+            /**
+            * How the data files are read.
+            */
+            DataSourceType dataSourceType;
+
+            /**
+            * How much of each file is checked against its checksums.
+            */
+            Verification verification;
+
+            /**
+            * The keys encrypted chunks are decrypted with, if set.
+            */
+            std::shared_ptr<const Crypto::KeyStore> keys;
+
+            /**
+            * The data files that have been mapped so far.
+            */
+            mutable std::map<size_t, std::shared_ptr<DataSource>> dataFiles;
+
+            /**
+            * Guards the data files.
+            */
+            mutable std::mutex dataFilesMutex;
+
             /**
             * Create path to a file.
             */
@@ -109,8 +156,13 @@ namespace Casc
             /**
             * Constructor.
             */
-            StreamAllocator(const std::string basePath)
-                : basePath(basePath)
+            StreamAllocator(const std::string basePath, std::shared_ptr<ThreadPool> pool = nullptr,
+                std::shared_ptr<BlockCache> cache = nullptr,
+                DataSourceType dataSourceType = DataSourceType::MemoryMapped,
+                Verification verification = Verification::None,
+                std::shared_ptr<const Crypto::KeyStore> keys = nullptr)
+                : basePath(basePath), pool(pool), cache(cache), dataSourceType(dataSourceType),
+                verification(verification), keys(keys)
             {
 
             }
@@ -157,6 +209,21 @@ namespace Casc
                     createPath(DataFolders::Data, ss.str()));
             }
 
+            /**
+            * Index file, mapped into memory.
+            */
+            std::shared_ptr<MappedFile> indexFile(uint32_t bucket, uint32_t version) const
+            {
+                std::stringstream ss;
+
+                ss << std::setw(2) << std::setfill('0') << std::hex << bucket;
+                ss << std::setw(8) << std::setfill('0') << std::hex << version;
+                ss << ".idx";
+
+                return std::make_shared<MappedFile>(
+                    createPath(DataFolders::Data, ss.str()));
+            }
+
             /**
             * Data
             */
@@ -173,14 +240,113 @@ namespace Casc
                     createPath(DataFolders::Data, ss.str()));
             }
 
+            /**
+            * Data file, opened once and shared by all streams.
+            * It is memory mapped, read by offset or read through a stream,
+            * depending on the data source type of the allocator.
+            */
+            std::shared_ptr<DataSource> dataFile(size_t number) const
+            {
+                std::lock_guard<std::mutex> lock(dataFilesMutex);
+
+                auto &source = dataFiles[number];
+
+                if (source == nullptr)
+                {
+                    std::stringstream ss;
+
+                    ss << "data." << std::setw(3) << std::setfill('0') << number;
+
+                    auto path = createPath(DataFolders::Data, ss.str());
+
+                    switch (dataSourceType)
+                    {
+                    case DataSourceType::MemoryMapped:
+                        source = std::make_shared<Impl::MemoryMappedSource>(std::make_shared<MappedFile>(path));
+                        break;
+
+                    case DataSourceType::File:
+                        source = std::make_shared<Impl::FileSource>(std::make_shared<PositionalFile>(path));
+                        break;
+
+                    case DataSourceType::Stream:
+                    {
+                        auto stream = allocate<false, std::ifstream>(path);
+                        stream->seekg(0, std::ios_base::end);
+                        auto size = stream->tellg();
+
+                        if (stream->fail() || size < 0)
+                        {
+                            throw Exceptions::IOException("Couldn't get the size of the file.");
+                        }
+
+                        source = std::make_shared<Impl::StreamSource>(stream, std::make_pair(size_t(0), size_t(size)));
+                        break;
+                    }
+                    }
+                }
+
+                return source;
+            }
+
             std::shared_ptr<Stream> data(const Parsers::Binary::Reference &ref) const
             {
-                std::stringstream ss;
+                return std::make_shared<Stream>(dataFile(ref.file()), ref.offset(), pool, cache, ref.key(), verification, keys);
+            }
+
+            /**
+            * Opens a batch of files in the order they are stored in, sorted by
+            * data file and offset, and passes each stream to the callback with
+            * the number it was listed with. Opens them on the thread pool if
+            * concurrent is set and there is one. Returns the numbers of the
+            * files that couldn't be opened.
+            */
+            template <typename Callback>
+            std::vector<size_t> data(std::vector<std::pair<size_t, Parsers::Binary::Reference>> refs,
+                Callback callback, bool concurrent = false) const
+            {
+                std::vector<size_t> failed;
+                std::mutex mutex;
+
+                std::sort(refs.begin(), refs.end(), [](const auto &a, const auto &b)
+                {
+                    return std::make_pair(a.second.file(), a.second.offset()) <
+                        std::make_pair(b.second.file(), b.second.offset());
+                });
+
+                auto open = [&](size_t i)
+                {
+                    std::shared_ptr<Stream> stream;
+
+                    try
+                    {
+                        stream = data(refs[i].second);
+                    }
+                    catch (Exceptions::CascException &)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        failed.push_back(refs[i].first);
+                        return;
+                    }
+
+                    callback(refs[i].first, stream);
+                };
+
+                if (concurrent && pool != nullptr)
+                {
+                    pool->parallelFor(refs.size(), open);
+                }
+                else
+                {
+                    for (auto i = 0U; i < refs.size(); ++i)
+                    {
+                        open(i);
+                    }
+                }
 
-                ss << "data." << std::setw(3) << std::setfill('0') << ref.file();
+                std::sort(failed.begin(), failed.end());
 
-                return std::make_shared<Stream>(
-                    createPath(DataFolders::Data, ss.str()), ref.offset());
+                return failed;
             }
         };
     }
@@ -0,0 +1,43 @@
+/*
+* Copyright 2015 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace Casc
+{
+    namespace IO
+    {
+        /**
+         * How much of a file is checked against its MD5 checksums when it is read.
+         */
+        enum class Verification
+        {
+            // Nothing is checked.
+            None,
+
+            // The block table is checked against the file key when the file is opened.
+            Header,
+
+            // The block table is checked, and every chunk is checked against the
+            // block table when it is first decoded. Chunks taken from the block
+            // cache have been checked already and aren't hashed again.
+            Full
+        };
+    }
+}
\ No newline at end of file
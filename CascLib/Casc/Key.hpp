@@ -0,0 +1,236 @@
+/*
+* Copyright 2015 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+
+#include "Exceptions/ParserException.hpp"
+
+namespace Casc
+{
+    /**
+     * A fixed size binary key, such as an MD5 hash or a truncated file key.
+     * Compared byte by byte; hex text is only produced when asked for.
+     */
+    template <size_t N>
+    class Key
+    {
+    public:
+        typedef uint8_t value_type;
+
+        // The number of bytes in the key.
+        static const size_t Size = N;
+
+    private:
+        // The key bytes.
+        std::array<value_type, N> bytes;
+
+        /**
+         * Converts a hex digit to its value.
+         */
+        static value_type digit(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+
+            throw Exceptions::ParserException("Invalid hex digit in key.");
+        }
+
+    public:
+        /**
+         * Default constructor. All bytes are zero.
+         */
+        Key()
+            : bytes{}
+        {
+        }
+
+        /**
+         * Constructor. Takes the first N bytes of the range.
+         */
+        template <typename InputIt>
+        Key(InputIt first, InputIt last)
+        {
+            if (last - first < static_cast<ptrdiff_t>(N))
+            {
+                throw Exceptions::ParserException("The key is too short.");
+            }
+
+            std::copy(first, first + N, bytes.begin());
+        }
+
+        /**
+         * Constructor. Takes the first N bytes of a longer key.
+         */
+        template <size_t M>
+        explicit Key(const Key<M> &key)
+        {
+            static_assert(M >= N, "The source key is too short.");
+
+            std::copy(key.begin(), key.begin() + N, bytes.begin());
+        }
+
+        /**
+         * Constructor. Parses the first N bytes of a hex string.
+         */
+        explicit Key(const std::string &str)
+        {
+            if (str.size() < N * 2)
+            {
+                throw Exceptions::ParserException("The key is too short.");
+            }
+
+            for (auto i = 0U; i < N; ++i)
+            {
+                bytes[i] = (digit(str[i * 2]) << 4) | digit(str[i * 2 + 1]);
+            }
+        }
+
+        /**
+         * Formats the key as lower case hex.
+         */
+        std::string string() const
+        {
+            static const char digits[] = "0123456789abcdef";
+
+            std::string str(N * 2, '0');
+
+            for (auto i = 0U; i < N; ++i)
+            {
+                str[i * 2] = digits[bytes[i] >> 4];
+                str[i * 2 + 1] = digits[bytes[i] & 0xF];
+            }
+
+            return str;
+        }
+
+        const value_type *data() const noexcept
+        {
+            return bytes.data();
+        }
+
+        value_type *data() noexcept
+        {
+            return bytes.data();
+        }
+
+        decltype(auto) begin() const noexcept
+        {
+            return bytes.cbegin();
+        }
+
+        decltype(auto) begin() noexcept
+        {
+            return bytes.begin();
+        }
+
+        decltype(auto) end() const noexcept
+        {
+            return bytes.cend();
+        }
+
+        decltype(auto) end() noexcept
+        {
+            return bytes.end();
+        }
+
+        constexpr size_t size() const noexcept
+        {
+            return N;
+        }
+
+        bool operator ==(const Key &b) const
+        {
+            return std::memcmp(bytes.data(), b.bytes.data(), N) == 0;
+        }
+
+        bool operator !=(const Key &b) const
+        {
+            return !(*this == b);
+        }
+
+        bool operator <(const Key &b) const
+        {
+            return std::memcmp(bytes.data(), b.bytes.data(), N) < 0;
+        }
+
+        bool operator >(const Key &b) const
+        {
+            return b < *this;
+        }
+
+        bool operator <=(const Key &b) const
+        {
+            return !(b < *this);
+        }
+
+        bool operator >=(const Key &b) const
+        {
+            return !(*this < b);
+        }
+    };
+
+    /**
+     * Writes the key as hex.
+     */
+    template <size_t N>
+    inline std::ostream &operator<<(std::ostream &stream, const Key<N> &key)
+    {
+        return stream << key.string();
+    }
+
+    // The first 9 bytes of a file key, as stored in the .idx files.
+    typedef Key<9> IndexKey;
+
+    // The key of an encoded file (the MD5 of its BLTE header).
+    typedef Key<16> FileKey;
+
+    // The MD5 of the content of a file.
+    typedef Key<16> FileHash;
+}
+
+namespace std
+{
+    /**
+     * The keys are hashes already, so their leading bytes are used as is.
+     */
+    template <size_t N>
+    struct hash<Casc::Key<N>>
+    {
+        size_t operator()(const Casc::Key<N> &key) const
+        {
+            size_t value = 0;
+            std::memcpy(&value, key.data(), std::min(sizeof(value), N));
+            return value;
+        }
+    };
+}
\ No newline at end of file
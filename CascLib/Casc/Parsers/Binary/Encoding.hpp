@@ -19,6 +19,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <string>
@@ -26,11 +30,16 @@
 #include <unordered_map>
 
 #include "../../Common.hpp"
+#include "../../Crypto/MD5.hpp"
 #include "../../Exceptions.hpp"
+#include "../../ThreadPool.hpp"
 
+#include "../../Parsers/Binary/PageVerification.hpp"
 #include "../../Parsers/Binary/Reference.hpp"
 #include "../../IO/StreamAllocator.hpp"
 #include "../../IO/Endian.hpp"
+#include "../../IO/MappedArray.hpp"
+#include "../../IO/Snapshot.hpp"
 
 namespace Casc
 {
@@ -46,25 +55,60 @@ namespace Casc
             public:
                 struct FileInfo
                 {
-                    Hex hash;
+                    FileHash hash;
                     size_t size;
-                    std::vector<Hex> keys;
+                    std::vector<FileKey> keys;
                 };
 
                 struct EncodedFileInfo
                 {
-                    Hex key;
+                    FileKey key;
                     size_t size;
                     std::string params;
                 };
 
+                // The size of the hashes and keys in the tables.
+                static const size_t HashSize = FileKey::Size;
+
+                /**
+                 * Find the first file key for a file hash.
+                 */
+                FileKey findKey(const FileHash &hash) const
+                {
+                    if (!decoded)
+                    {
+                        return findFileInfo(hash).keys.at(0);
+                    }
+
+                    auto it = findContentEntry(hash);
+
+                    if (it == contentEntries.end())
+                    {
+                        throw Exceptions::HashDoesNotExistException(hash.string());
+                    }
+
+                    return keys[it->firstKey];
+                }
+
                 /**
                  * Find the file info for a file hash.
                  */
-                FileInfo findFileInfo(Hex hash) const
+                FileInfo findFileInfo(const FileHash &hash) const
                 {
+                    if (decoded)
+                    {
+                        auto it = findContentEntry(hash);
+
+                        if (it == contentEntries.end())
+                        {
+                            throw Exceptions::HashDoesNotExistException(hash.string());
+                        }
+
+                        return toFileInfo(*it);
+                    }
+
                     auto index = -1;
-                    Hex checksum;
+                    FileKey checksum;
 
                     for (auto i = 0U; i < headersA.size(); ++i)
                     {
@@ -97,10 +141,22 @@ namespace Casc
                 /**
                  * Find the encoding info for a file key.
                  */
-                EncodedFileInfo findEncodedFileInfo(Hex key) const
+                EncodedFileInfo findEncodedFileInfo(const FileKey &key) const
                 {
+                    if (decoded)
+                    {
+                        auto it = findEncodedEntry(key);
+
+                        if (it == encodedEntries.end())
+                        {
+                            throw Exceptions::KeyDoesNotExistException(key.string());
+                        }
+
+                        return toEncodedFileInfo(*it);
+                    }
+
                     auto index = -1;
-                    Hex checksum;
+                    FileKey checksum;
 
                     for (auto i = 0U; i < headersB.size(); ++i)
                     {
@@ -137,12 +193,22 @@ namespace Casc
                 {
                     std::vector<FileInfo> list;
 
+                    if (decoded)
+                    {
+                        for (auto i = offset; i < contentEntries.size() && list.size() < count; ++i)
+                        {
+                            list.emplace_back(toFileInfo(contentEntries[i]));
+                        }
+
+                        return list;
+                    }
+
                     while (list.size() < count)
                     {
                         auto remaining = count - list.size();
 
                         auto index = -1;
-                        Hex checksum;
+                        FileKey checksum;
 
                         if (offset < headersA.size())
                         {
@@ -157,7 +223,7 @@ namespace Casc
                         auto files = parseEntry(index, checksum);
                         auto n = remaining < files.size() ? remaining : files.size();
 
-                        files.insert(list.end(), files.begin(), files.begin() + n);
+                        list.insert(list.end(), files.begin(), files.begin() + n);
 
                         offset += n;
                     }
@@ -172,12 +238,22 @@ namespace Casc
                 {
                     std::vector<EncodedFileInfo> list;
 
+                    if (decoded)
+                    {
+                        for (auto i = offset; i < encodedEntries.size() && list.size() < count; ++i)
+                        {
+                            list.emplace_back(toEncodedFileInfo(encodedEntries[i]));
+                        }
+
+                        return list;
+                    }
+
                     while (list.size() < count)
                     {
-                        auto remaining = list.size() - count;
+                        auto remaining = count - list.size();
 
                         auto index = -1;
-                        Hex checksum;
+                        FileKey checksum;
 
                         if (offset < headersB.size())
                         {
@@ -189,17 +265,48 @@ namespace Casc
                             break;
                         }
 
-                        auto files = parseEncodedEntry(index, headersB[index].second);
-                        auto count = remaining < files.size() ? remaining : files.size();
+                        auto files = parseEncodedEntry(index, checksum);
+                        auto n = remaining < files.size() ? remaining : files.size();
 
-                        files.insert(list.end(), files.begin(), files.begin() + count);
+                        list.insert(list.end(), files.begin(), files.begin() + n);
 
-                        offset += count;
+                        offset += n;
                     }
 
                     return list;
                 }
 
+                /**
+                 * Writes the decoded tables to a snapshot. The tables must have
+                 * been decoded when the encoding file was loaded.
+                 */
+                void save(IO::SnapshotWriter &writer) const
+                {
+                    if (!decoded)
+                    {
+                        throw Exceptions::ParserException("Only decoded encoding tables can be saved.");
+                    }
+
+                    writer.write(verification);
+                    writer.write(contentEntries.data(), contentEntries.size());
+                    writer.write(keys.data(), keys.size());
+                    writer.write(encodedEntries.data(), encodedEntries.size());
+                    writer.write(static_cast<uint32_t>(profiles.size()));
+
+                    for (auto &profile : profiles)
+                    {
+                        writer.write(profile);
+                    }
+                }
+
+                /**
+                 * When the pages were verified.
+                 */
+                PageVerification pageVerification() const
+                {
+                    return verification;
+                }
+
             private:
                 // The file signature.
                 static const uint16_t Signature = 0x4E45;
@@ -210,17 +317,441 @@ namespace Casc
                 // The size of each chunk body (second block for each table).
                 static const unsigned int EntrySize = 4096U;
 
-                std::vector<std::pair<Hex, Hex>> headersA;
+                // The number of pages hashed together when verifying a whole table.
+                static const size_t PagesPerBatch = 64U;
+
+                // The first hash and the MD5 of each page, last page first.
+                std::vector<std::pair<FileHash, FileKey>> headersA;
                 std::vector<char> tableA;
                 size_t hashSizeA;
 
-                std::vector<std::pair<Hex, Hex>> headersB;
+                // The first key and the MD5 of each page, last page first.
+                std::vector<std::pair<FileKey, FileKey>> headersB;
                 std::vector<char> tableB;
                 size_t hashSizeB;
 
                 // The encoding profiles
                 std::vector<std::string> profiles;
 
+                /**
+                 * A decoded record of table A.
+                 */
+                struct ContentEntry
+                {
+                    // The content hash of the file.
+                    FileHash hash;
+
+                    // The decoded size of the file.
+                    uint32_t size;
+
+                    // The position of the first file key in the key array.
+                    uint32_t firstKey;
+
+                    // The number of file keys.
+                    uint32_t keyCount;
+                };
+
+                /**
+                 * A decoded record of table B.
+                 */
+                struct EncodedEntry
+                {
+                    // The file key.
+                    FileKey key;
+
+                    // The encoded size of the file.
+                    uint32_t size;
+
+                    // The encoding profile, or -1 if there is none.
+                    int32_t profile;
+                };
+
+                /**
+                 * One bit per page, set once the page has been verified.
+                 */
+                class PageBitmap
+                {
+                    // The number of pages.
+                    size_t size = 0;
+
+                    // The bits, 64 pages per word.
+                    std::unique_ptr<std::atomic<uint64_t>[]> words;
+
+                public:
+                    /**
+                     * Constructor.
+                     */
+                    PageBitmap(size_t size = 0)
+                        : size(size), words(new std::atomic<uint64_t>[(size + 63) / 64]())
+                    {
+                    }
+
+                    /**
+                     * Copy constructor.
+                     */
+                    PageBitmap(const PageBitmap &other)
+                        : PageBitmap(other.size)
+                    {
+                        for (auto i = 0U; i < (size + 63) / 64; ++i)
+                        {
+                            words[i] = other.words[i].load();
+                        }
+                    }
+
+                    /**
+                     * Move constructor.
+                     */
+                    PageBitmap(PageBitmap &&) = default;
+
+                    /**
+                     * Copy operator.
+                     */
+                    PageBitmap &operator= (const PageBitmap &other)
+                    {
+                        return *this = PageBitmap(other);
+                    }
+
+                    /**
+                     * Move operator.
+                     */
+                    PageBitmap &operator= (PageBitmap &&) = default;
+
+                    /**
+                     * Destructor.
+                     */
+                    virtual ~PageBitmap() = default;
+
+                    /**
+                     * Checks if a page has been verified.
+                     */
+                    bool test(size_t page) const
+                    {
+                        return (words[page / 64].load(std::memory_order_acquire) >> (page % 64)) & 1U;
+                    }
+
+                    /**
+                     * Marks a page as verified.
+                     */
+                    void set(size_t page)
+                    {
+                        words[page / 64].fetch_or(uint64_t(1) << (page % 64), std::memory_order_release);
+                    }
+                };
+
+                // When the pages are verified.
+                PageVerification verification = PageVerification::LazyOnce;
+
+                // The verified pages of table A.
+                mutable PageBitmap verifiedA;
+
+                // The verified pages of table B.
+                mutable PageBitmap verifiedB;
+
+                // True when the tables have been decoded into the arrays below.
+                bool decoded = false;
+
+                // Table A sorted by content hash.
+                IO::MappedArray<ContentEntry> contentEntries;
+
+                // The file keys of table A.
+                IO::MappedArray<FileKey> keys;
+
+                // Table B sorted by file key.
+                IO::MappedArray<EncodedEntry> encodedEntries;
+
+                /**
+                 * Binary search in table A.
+                 */
+                IO::MappedArray<ContentEntry>::const_iterator findContentEntry(const FileHash &hash) const
+                {
+                    auto it = std::lower_bound(contentEntries.begin(), contentEntries.end(), hash,
+                        [](const ContentEntry &entry, const FileHash &value)
+                    {
+                        return entry.hash < value;
+                    });
+
+                    if (it != contentEntries.end() && it->hash != hash)
+                    {
+                        return contentEntries.end();
+                    }
+
+                    return it;
+                }
+
+                /**
+                 * Binary search in table B.
+                 */
+                IO::MappedArray<EncodedEntry>::const_iterator findEncodedEntry(const FileKey &key) const
+                {
+                    auto it = std::lower_bound(encodedEntries.begin(), encodedEntries.end(), key,
+                        [](const EncodedEntry &entry, const FileKey &value)
+                    {
+                        return entry.key < value;
+                    });
+
+                    if (it != encodedEntries.end() && it->key != key)
+                    {
+                        return encodedEntries.end();
+                    }
+
+                    return it;
+                }
+
+                /**
+                 * Converts a decoded record of table A.
+                 */
+                FileInfo toFileInfo(const ContentEntry &entry) const
+                {
+                    FileInfo info{ entry.hash, entry.size, {} };
+
+                    for (auto i = 0U; i < entry.keyCount; ++i)
+                    {
+                        info.keys.emplace_back(keys[entry.firstKey + i]);
+                    }
+
+                    return info;
+                }
+
+                /**
+                 * Converts a decoded record of table B.
+                 */
+                EncodedFileInfo toEncodedFileInfo(const EncodedEntry &entry) const
+                {
+                    return EncodedFileInfo{ entry.key, entry.size,
+                        entry.profile >= 0 && size_t(entry.profile) < profiles.size() ? profiles[entry.profile] : "" };
+                }
+
+                /**
+                 * Checks the MD5 of a page against the page header.
+                 */
+                static void verifyPage(std::vector<char>::const_iterator begin, const FileKey &checksum)
+                {
+                    auto digest = MD5(begin, begin + EntrySize).rawdigest();
+                    FileKey actual(digest.begin(), digest.end());
+
+                    if (actual != checksum)
+                    {
+                        throw Exceptions::InvalidHashException(Crypto::lookup3(checksum, 0), Crypto::lookup3(actual, 0), "");
+                    }
+                }
+
+                /**
+                 * Checks the MD5 of a page unless it has been checked before.
+                 */
+                void verifyPage(PageBitmap &verified, size_t page,
+                    std::vector<char>::const_iterator begin, const FileKey &checksum) const
+                {
+                    if (verification == PageVerification::Off || verified.test(page))
+                    {
+                        return;
+                    }
+
+                    verifyPage(begin, checksum);
+                    verified.set(page);
+                }
+
+                /**
+                 * Verifies every page of both tables. The pages are hashed in
+                 * batches, several at once in parallel lanes.
+                 */
+                void verifyAll(std::shared_ptr<ThreadPool> pool)
+                {
+                    auto pages = headersA.size() + headersB.size();
+                    auto batches = (pages + PagesPerBatch - 1) / PagesPerBatch;
+
+                    auto verify = [&](size_t batch)
+                    {
+                        std::vector<std::pair<const char*, size_t>> data;
+                        std::vector<size_t> indices;
+
+                        for (auto i = batch * PagesPerBatch; i < std::min(pages, (batch + 1) * PagesPerBatch); ++i)
+                        {
+                            auto &verified = i < headersA.size() ? verifiedA : verifiedB;
+                            auto page = i < headersA.size() ? i : i - headersA.size();
+
+                            if (!verified.test(page))
+                            {
+                                auto &table = i < headersA.size() ? tableA : tableB;
+
+                                data.emplace_back(table.data() + EntrySize * page, size_t(EntrySize));
+                                indices.push_back(i);
+                            }
+                        }
+
+                        auto digests = Crypto::md5Many(data);
+
+                        for (auto k = 0U; k < indices.size(); ++k)
+                        {
+                            // The headers are stored in reverse page order.
+                            auto i = indices[k];
+                            auto &verified = i < headersA.size() ? verifiedA : verifiedB;
+                            auto page = i < headersA.size() ? i : i - headersA.size();
+                            auto &checksum = i < headersA.size() ?
+                                headersA[headersA.size() - 1 - page].second : headersB[headersB.size() - 1 - page].second;
+
+                            FileKey actual(digests[k].begin(), digests[k].end());
+
+                            if (actual != checksum)
+                            {
+                                throw Exceptions::InvalidHashException(Crypto::lookup3(checksum, 0), Crypto::lookup3(actual, 0), "");
+                            }
+
+                            verified.set(page);
+                        }
+                    };
+
+                    if (pool != nullptr)
+                    {
+                        pool->parallelFor(batches, verify);
+                    }
+                    else
+                    {
+                        for (auto i = 0U; i < batches; ++i)
+                        {
+                            verify(i);
+                        }
+                    }
+                }
+
+                /**
+                 * Decodes both tables into sorted arrays and releases the pages.
+                 */
+                void decode(std::shared_ptr<ThreadPool> pool)
+                {
+                    std::vector<std::vector<ContentEntry>> pagesA(headersA.size());
+                    std::vector<std::vector<FileKey>> pageKeys(headersA.size());
+                    std::vector<std::vector<EncodedEntry>> pagesB(headersB.size());
+
+                    // The headers are stored in reverse page order.
+                    auto decodePage = [&](size_t i)
+                    {
+                        if (i < pagesA.size())
+                        {
+                            auto begin = tableA.cbegin() + EntrySize * i;
+                            auto end = begin + EntrySize;
+
+                            verifyPage(verifiedA, i, begin, headersA[headersA.size() - 1 - i].second);
+
+                            for (auto it = begin; end - it >= 6;)
+                            {
+                                auto keyCount = IO::Endian::read<IO::EndianType::Little, uint16_t>(it);
+
+                                if (keyCount == 0 || end - it < ptrdiff_t(6 + HashSize * (1U + keyCount)))
+                                {
+                                    break;
+                                }
+
+                                auto fileSize = IO::Endian::read<IO::EndianType::Big, uint32_t>(it + 2);
+                                it += 6;
+
+                                ContentEntry entry;
+                                entry.hash = FileHash(it, it + HashSize);
+                                entry.size = fileSize;
+                                entry.firstKey = static_cast<uint32_t>(pageKeys[i].size());
+                                entry.keyCount = keyCount;
+                                it += HashSize;
+
+                                for (auto k = 0U; k < keyCount; ++k, it += HashSize)
+                                {
+                                    pageKeys[i].emplace_back(it, it + HashSize);
+                                }
+
+                                pagesA[i].emplace_back(entry);
+                            }
+                        }
+                        else
+                        {
+                            auto page = i - pagesA.size();
+                            auto begin = tableB.cbegin() + EntrySize * page;
+                            auto end = begin + EntrySize;
+
+                            verifyPage(verifiedB, page, begin, headersB[headersB.size() - 1 - page].second);
+
+                            for (auto it = begin; end - it >= ptrdiff_t(HashSize + 9); it += HashSize + 9)
+                            {
+                                // The rest of the page is zero filled.
+                                if (std::all_of(it, it + HashSize, [](char c) { return c == 0; }))
+                                {
+                                    break;
+                                }
+
+                                EncodedEntry entry;
+                                entry.key = FileKey(it, it + HashSize);
+                                entry.profile = IO::Endian::read<IO::EndianType::Big, int32_t>(it + HashSize);
+                                entry.size = IO::Endian::read<IO::EndianType::Big, uint32_t>(it + HashSize + 5);
+
+                                pagesB[page].emplace_back(entry);
+                            }
+                        }
+                    };
+
+                    auto pages = pagesA.size() + pagesB.size();
+
+                    if (pool != nullptr)
+                    {
+                        pool->parallelFor(pages, decodePage);
+                    }
+                    else
+                    {
+                        for (auto i = 0U; i < pages; ++i)
+                        {
+                            decodePage(i);
+                        }
+                    }
+
+                    std::vector<ContentEntry> contentEntries;
+                    std::vector<FileKey> keys;
+                    std::vector<EncodedEntry> encodedEntries;
+
+                    for (auto i = 0U; i < pagesA.size(); ++i)
+                    {
+                        auto base = static_cast<uint32_t>(keys.size());
+
+                        for (auto &entry : pagesA[i])
+                        {
+                            entry.firstKey += base;
+                            contentEntries.emplace_back(entry);
+                        }
+
+                        keys.insert(keys.end(), pageKeys[i].begin(), pageKeys[i].end());
+                    }
+
+                    for (auto &page : pagesB)
+                    {
+                        encodedEntries.insert(encodedEntries.end(), page.begin(), page.end());
+                    }
+
+                    // The pages are sorted already, but the lookups depend on it.
+                    auto byHash = [](const ContentEntry &a, const ContentEntry &b)
+                    {
+                        return std::memcmp(a.hash.data(), b.hash.data(), HashSize) < 0;
+                    };
+
+                    auto byKey = [](const EncodedEntry &a, const EncodedEntry &b)
+                    {
+                        return std::memcmp(a.key.data(), b.key.data(), HashSize) < 0;
+                    };
+
+                    if (!std::is_sorted(contentEntries.begin(), contentEntries.end(), byHash))
+                    {
+                        std::stable_sort(contentEntries.begin(), contentEntries.end(), byHash);
+                    }
+
+                    if (!std::is_sorted(encodedEntries.begin(), encodedEntries.end(), byKey))
+                    {
+                        std::stable_sort(encodedEntries.begin(), encodedEntries.end(), byKey);
+                    }
+
+                    this->contentEntries = IO::MappedArray<ContentEntry>(std::move(contentEntries));
+                    this->keys = IO::MappedArray<FileKey>(std::move(keys));
+                    this->encodedEntries = IO::MappedArray<EncodedEntry>(std::move(encodedEntries));
+
+                    std::vector<char>().swap(tableA);
+                    std::vector<char>().swap(tableB);
+
+                    decoded = true;
+                }
+
                 /**
                 * Reads data from a stream and puts it in a struct.
                 */
@@ -236,19 +767,14 @@ namespace Casc
                 /**
                  * Parse an entry in the table.
                  */
-                std::vector<FileInfo> parseEntry(uint32_t index, Hex checksum) const
+                std::vector<FileInfo> parseEntry(uint32_t index, const FileKey &checksum) const
                 {
                     std::vector<FileInfo> files;
 
                     auto begin = tableA.begin() + EntrySize * index;
                     auto end = begin + EntrySize;
 
-                    Hex actual(md5(begin, end));
-
-                    if (actual != checksum)
-                    {
-                        throw Exceptions::InvalidHashException(Crypto::lookup3(checksum, 0), Crypto::lookup3(actual, 0), "");
-                    }
+                    verifyPage(verifiedA, index, begin, checksum);
 
                     for (auto it = begin; it < end;)
                     {
@@ -266,7 +792,7 @@ namespace Casc
                         auto checksumIt = it;
                         it += hashSizeA;
 
-                        std::vector<Hex> keys;
+                        std::vector<FileKey> keys;
 
                         for (auto i = 0U; i < keyCount; ++i)
                         {
@@ -274,7 +800,7 @@ namespace Casc
                             it += hashSizeA;
                         }
 
-                        files.emplace_back(FileInfo{ { checksumIt, checksumIt + hashSizeA }, fileSize, keys });
+                        files.emplace_back(FileInfo{ FileHash(checksumIt, checksumIt + hashSizeA), fileSize, keys });
                     }
 
                     return files;
@@ -283,21 +809,16 @@ namespace Casc
                 /**
                  * Parse an entry in the table.
                  */
-                std::vector<EncodedFileInfo> parseEncodedEntry(uint32_t index, Hex checksum) const
+                std::vector<EncodedFileInfo> parseEncodedEntry(uint32_t index, const FileKey &checksum) const
                 {
                     std::vector<EncodedFileInfo> files;
 
                     auto begin = tableB.begin() + EntrySize * index;
                     auto end = begin + EntrySize;
 
-                    Hex actual(md5(begin, end));
+                    verifyPage(verifiedB, index, begin, checksum);
 
-                    if (actual != checksum)
-                    {
-                        throw Exceptions::InvalidHashException(Crypto::lookup3(checksum, 0), Crypto::lookup3(actual, 0), "");
-                    }
-
-                    for (auto it = begin; it < end;)
+                    for (auto it = begin; end - it >= ptrdiff_t(hashSizeB + 9);)
                     {
                         auto checksumIt = it;
                         it += hashSizeB;
@@ -312,15 +833,13 @@ namespace Casc
                             IO::Endian::read<IO::EndianType::Big, uint32_t>(it);
                         it += sizeof(fileSize);
 
-                        auto &profile = profiles[profileIndex];
-
-                        if (profileIndex >= 0)
+                        if (profileIndex >= 0 && size_t(profileIndex) < profiles.size())
                         {
-                            files.emplace_back(EncodedFileInfo{ { checksumIt, checksumIt + hashSizeB }, fileSize, profile });
+                            files.emplace_back(EncodedFileInfo{ FileKey(checksumIt, checksumIt + hashSizeB), fileSize, profiles[profileIndex] });
                         }
                         else
                         {
-                            files.emplace_back(EncodedFileInfo{ { checksumIt, checksumIt + hashSizeB }, fileSize, "" });
+                            files.emplace_back(EncodedFileInfo{ FileKey(checksumIt, checksumIt + hashSizeB), fileSize, "" });
                         }
                     }
 
@@ -350,6 +869,11 @@ namespace Casc
                     uint8_t hashSizeB;
                     this->hashSizeB = read<IO::EndianType::Little, uint8_t>(stream, hashSizeB);
 
+                    if (this->hashSizeA != HashSize || this->hashSizeB != HashSize)
+                    {
+                        throw Exceptions::ParserException("Only 16 byte hashes are supported.");
+                    }
+
                     stream->seekg(4, std::ios_base::cur); // Skip flags
 
                     uint32_t tableSizeA;
@@ -383,11 +907,11 @@ namespace Casc
                     // Table A
                     for (auto i = 0U; i < tableSizeA; ++i)
                     {
-                        std::vector<char> hash(hashSizeA);
-                        std::vector<char> checksum(hashSizeA);
+                        FileHash hash;
+                        FileKey checksum;
 
-                        stream->read(hash.data(), hashSizeA);
-                        stream->read(checksum.data(), hashSizeA);
+                        stream->read(reinterpret_cast<char*>(hash.data()), HashSize);
+                        stream->read(reinterpret_cast<char*>(checksum.data()), HashSize);
 
                         headersA.emplace_back(std::make_pair(hash, checksum));
                     }
@@ -401,11 +925,11 @@ namespace Casc
 
                     for (auto i = 0U; i < tableSizeB; ++i)
                     {
-                        std::vector<char> hash(hashSizeA);
-                        std::vector<char> checksum(hashSizeA);
+                        FileKey hash;
+                        FileKey checksum;
 
-                        stream->read(hash.data(), hashSizeA);
-                        stream->read(checksum.data(), hashSizeA);
+                        stream->read(reinterpret_cast<char*>(hash.data()), HashSize);
+                        stream->read(reinterpret_cast<char*>(checksum.data()), HashSize);
 
                         headersB.emplace_back(std::make_pair(hash, checksum));
                     }
@@ -415,6 +939,9 @@ namespace Casc
                     tableB.resize(EntrySize * tableSizeB);
                     stream->read(tableB.data(), tableB.size());
 
+                    verifiedA = PageBitmap(tableSizeA);
+                    verifiedB = PageBitmap(tableSizeB);
+
                     // Encoding profile for this file
 
                     std::string profile;
@@ -428,7 +955,11 @@ namespace Casc
                  * Constructor.
                  */
                 Encoding(Parsers::Binary::Reference ref,
-                         std::shared_ptr<IO::StreamAllocator> allocator)
+                         std::shared_ptr<IO::StreamAllocator> allocator,
+                         bool decodeTables = false,
+                         PageVerification verification = PageVerification::LazyOnce,
+                         std::shared_ptr<ThreadPool> pool = nullptr)
+                    : verification(verification)
                 {
                     // Get a file stream.
                      auto fs = allocator->data<true, false>(ref.file());
@@ -455,12 +986,71 @@ namespace Casc
                             ZInflateStream(reinterpret_cast<ZStreamBase::char_t*>(
                                 buf.data() + i - 1), inSize).readAll(&out, outSize);
                             params.assign(reinterpret_cast<char*>(out), outSize);
+                            delete[] out;
                             break;
                         }
                     }
 
                     // Parse CASC stream.
                     parse(allocator->data(ref));
+
+                    // Decoding reads every page, so the pages are checked up front
+                    // in batches rather than one at a time as they are decoded.
+                    if (verification == PageVerification::Eager ||
+                        (verification != PageVerification::Off && decodeTables))
+                    {
+                        verifyAll(pool);
+                    }
+
+                    if (decodeTables)
+                    {
+                        decode(pool);
+                    }
+                }
+
+                /**
+                 * Constructor. Loads decoded tables written to a snapshot by save.
+                 */
+                Encoding(IO::SnapshotReader &reader)
+                    : hashSizeA(HashSize), hashSizeB(HashSize), decoded(true)
+                {
+                    verification = reader.read<PageVerification>();
+                    contentEntries = reader.readArray<ContentEntry>();
+                    keys = reader.readArray<FileKey>();
+                    encodedEntries = reader.readArray<EncodedEntry>();
+
+                    for (auto i = reader.read<uint32_t>(); i > 0; --i)
+                    {
+                        profiles.emplace_back(reader.readString());
+                    }
+
+                    auto invalidContent = std::find_if(contentEntries.begin(), contentEntries.end(), [this](const ContentEntry &entry)
+                    {
+                        return entry.keyCount == 0 || uint64_t(entry.firstKey) + entry.keyCount > keys.size();
+                    });
+
+                    auto invalidEncoded = std::find_if(encodedEntries.begin(), encodedEntries.end(), [this](const EncodedEntry &entry)
+                    {
+                        return entry.profile < -1 || (entry.profile >= 0 && size_t(entry.profile) >= profiles.size());
+                    });
+
+                    auto contentSorted = std::is_sorted(contentEntries.begin(), contentEntries.end(),
+                        [](const ContentEntry &a, const ContentEntry &b)
+                    {
+                        return a.hash < b.hash;
+                    });
+
+                    auto encodedSorted = std::is_sorted(encodedEntries.begin(), encodedEntries.end(),
+                        [](const EncodedEntry &a, const EncodedEntry &b)
+                    {
+                        return a.key < b.key;
+                    });
+
+                    if (invalidContent != contentEntries.end() || invalidEncoded != encodedEntries.end() ||
+                        !contentSorted || !encodedSorted)
+                    {
+                        throw Exceptions::ParserException("The snapshot has invalid encoding tables.");
+                    }
                 }
 
                 /**
@@ -19,16 +19,20 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <functional>
 #include <fstream>
 #include <map>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "../../Common.hpp"
 #include "../../Exceptions.hpp"
+#include "../../ThreadPool.hpp"
+#include "../../IO/MappedArray.hpp"
+#include "../../IO/Snapshot.hpp"
 
 #include "Reference.hpp"
 
@@ -44,8 +48,43 @@ namespace Casc
             class Index
             {
             private:
-                // The files listed in the index.
-                std::unordered_map<uint32_t, Reference> files_;
+                // The number of key bytes stored in the index.
+                static const size_t KeySize = IndexKey::Size;
+
+                /**
+                 * A file record, packed to keep the index small.
+                 */
+                struct Entry
+                {
+                    // The offset into the data file.
+                    uint32_t offset;
+
+                    // The amount of bytes in the memory block.
+                    uint32_t size;
+
+                    // The data file number.
+                    uint16_t file;
+
+                    // The first bytes of the file key.
+                    IndexKey key;
+
+                    // Unused. Named so the record has no padding, which would be
+                    // written to snapshots uninitialized.
+                    uint8_t reserved;
+
+                    bool operator <(const Entry &b) const
+                    {
+                        return key < b.key;
+                    }
+
+                    bool operator ==(const Entry &b) const
+                    {
+                        return key == b.key;
+                    }
+                };
+
+                // The files listed in the index, sorted by key.
+                IO::MappedArray<Entry> files_;
 
                 // The versions of the .idx files.
                 std::map<uint32_t, uint32_t> versions_;
@@ -69,74 +108,128 @@ namespace Casc
                     return (xorred & 0xF) ^ (xorred >> 4);
                 }
 
+                /**
+                 * Parses a file record from an .idx file.
+                 */
+                template <typename InputIt>
+                static Entry parseEntry(InputIt it, size_t locationSize, size_t lengthSize, size_t segmentBits)
+                {
+                    Entry entry{};
+
+                    entry.key = IndexKey(it, it + KeySize);
+                    it += KeySize;
+
+                    // The location is a big endian value where the upper bits are
+                    // the data file number and the lower bits are the offset.
+                    uint64_t location = 0;
+
+                    for (auto i = 0U; i < locationSize; ++i, ++it)
+                    {
+                        location = (location << 8) | uint8_t(*it);
+                    }
+
+                    entry.file = static_cast<uint16_t>(location >> segmentBits);
+                    entry.offset = static_cast<uint32_t>(location & ((uint64_t(1) << segmentBits) - 1));
+                    entry.size = IO::Endian::read<IO::EndianType::Little, uint32_t>(it, it + lengthSize);
+
+                    return entry;
+                }
+
+                /**
+                 * The contents of an .idx file.
+                 */
+                struct IndexFile
+                {
+                    // The bucket the file belongs to.
+                    uint32_t bucket;
+
+                    // The version of the file format.
+                    uint32_t version;
+
+                    // The size of the keys in the file.
+                    uint32_t keySize;
+
+                    // The file records, sorted by key.
+                    std::vector<Entry> files;
+                };
+
+                /**
+                 * Throws if a range is outside of the .idx file.
+                 */
+                static void checkBounds(size_t offset, size_t count, size_t size)
+                {
+                    if (offset > size || count > size - offset)
+                    {
+                        throw Exceptions::ParserException("Unexpected end of .idx file.");
+                    }
+                }
+
                 /**
                  * Parses an .idx file.
                  */
-                std::vector<Reference> parse(std::ifstream& fs)
+                static IndexFile parse(const char *data, size_t length)
                 {
-                    uint32_t size;
-                    uint32_t hash;
+                    IndexFile result;
+
+                    checkBounds(0, 8, length);
 
-                    fs >> le >> size;
-                    fs >> le >> hash;
+                    auto size = IO::Endian::read<IO::EndianType::Little, uint32_t>(data);
+                    auto hash = IO::Endian::read<IO::EndianType::Little, uint32_t>(data + 4);
+
+                    checkBounds(8, std::max(size, 8U), length);
 
                     uint32_t headerHash{ 0 };
-                    if ((hash != (headerHash = Crypto::lookup3(fs, size, 0))))
+                    if ((hash != (headerHash = Crypto::lookup3(data + 8, data + 8 + size, 0))))
                     {
                         throw Exceptions::InvalidHashException(hash, headerHash, "");
                     }
 
-                    uint16_t version;
-                    uint16_t bucket;
-
-                    uint8_t lengthFieldSize;
-                    uint8_t locationFieldSize;
-                    uint8_t keyFieldSize;
-                    uint8_t segmentBits;
+                    auto version = IO::Endian::read<IO::EndianType::Little, uint16_t>(data + 8);
+                    auto bucket = IO::Endian::read<IO::EndianType::Little, uint16_t>(data + 10);
 
-                    fs >> le >> version;
-                    fs >> le >> bucket;
-                    fs >> lengthFieldSize;
-                    fs >> locationFieldSize;
-                    fs >> keyFieldSize;
-                    fs >> segmentBits;
+                    uint8_t lengthFieldSize = data[12];
+                    uint8_t locationFieldSize = data[13];
+                    uint8_t keyFieldSize = data[14];
+                    uint8_t segmentBits = data[15];
 
-                    this->versions_[bucket] = version;
-                    this->keySize_[bucket] = keyFieldSize;
+                    result.bucket = bucket;
+                    result.version = version;
+                    result.keySize = keyFieldSize;
 
-                    for (unsigned int i = 0; i < (size - 8); i += 8)
+                    if (keyFieldSize != KeySize || locationFieldSize > sizeof(uint64_t) ||
+                        lengthFieldSize > sizeof(uint32_t) || segmentBits >= 64)
                     {
-                        uint32_t dataBeg;
-                        uint32_t dataEnd;
-
-                        fs >> be >> dataBeg;
-                        fs >> be >> dataEnd;
+                        throw Exceptions::ParserException("Field size is outside the accepted range of the index.");
                     }
 
-                    fs.seekg(16 - ((8 + size) % 16), std::ios_base::cur);
+                    // The file records start at the next 16 byte boundary.
+                    size_t offset = (8U + size + 15U) & ~size_t(15U);
 
-                    fs >> le >> size;
-                    fs >> le >> hash;
+                    checkBounds(offset, 8, length);
+
+                    size = IO::Endian::read<IO::EndianType::Little, uint32_t>(data + offset);
+                    hash = IO::Endian::read<IO::EndianType::Little, uint32_t>(data + offset + 4);
+                    offset += 8;
+
+                    checkBounds(offset, size, length);
 
                     std::pair<uint32_t, uint32_t> dataHash{ 0, 0 };
-                    std::vector<char> data(size);
 
-                    fs.read(data.data(), data.size());
+                    auto entrySize = keyFieldSize + locationFieldSize + lengthFieldSize;
 
-                    std::vector<Reference> files(size / 18);
-                    files.reserve(size / 18);
+                    result.files.reserve(size / entrySize);
 
-                    for (auto i = 0U; i < (size / 18); ++i)
+                    for (auto i = 0U; i < (size / entrySize); ++i)
                     {
-                        auto begin = data.begin() + 18 * i;
-                        auto end = begin + 18;
+                        auto begin = data + offset + entrySize * i;
+                        auto end = begin + entrySize;
 
-                        files.emplace_back(begin, end,
-                            keyFieldSize,
+                        result.files.emplace_back(parseEntry(begin,
                             locationFieldSize,
                             lengthFieldSize,
-                            segmentBits);
+                            segmentBits));
 
+                        // The checksum is chained through every record.
                         dataHash = Crypto::lookup3(begin, end, dataHash);
                     }
 
@@ -145,27 +238,106 @@ namespace Casc
                         throw Exceptions::InvalidHashException(hash, dataHash.first, "");
                     }
 
-                    fs.seekg(0xE000 - ((8 + size) % 0xD000), std::ios_base::cur);
+                    // Keep the first record when a key is listed more than once.
+                    std::stable_sort(result.files.begin(), result.files.end());
+                    result.files.erase(std::unique(result.files.begin(), result.files.end()), result.files.end());
 
-                    return files;
+                    return result;
                 }
 
                 /**
-                 * Parses the .idx files.
+                 * Parses the .idx files, one task per file.
                  */
                 void parse(const std::map<uint32_t, uint32_t> &versions,
-                    std::shared_ptr<IO::StreamAllocator> allocator)
+                    std::shared_ptr<IO::StreamAllocator> allocator,
+                    std::shared_ptr<ThreadPool> pool)
                 {
                     versions_ = versions;
 
-                    for (auto i = 0; i < (int)versions.size(); ++i)
+                    std::vector<std::pair<uint32_t, uint32_t>> list(versions.begin(), versions.end());
+                    std::vector<IndexFile> parsed(list.size());
+
+                    auto parseFile = [&](size_t i)
+                    {
+                        auto file = allocator->indexFile(list[i].first, list[i].second);
+                        parsed[i] = parse(file->data(), file->size());
+                    };
+
+                    if (pool != nullptr)
+                    {
+                        pool->parallelFor(list.size(), parseFile);
+                    }
+                    else
+                    {
+                        for (auto i = 0U; i < list.size(); ++i)
+                        {
+                            parseFile(i);
+                        }
+                    }
+
+                    // Each bucket holds a distinct set of keys, so the sorted
+                    // buckets only have to be merged.
+                    std::vector<size_t> runs{ 0 };
+                    size_t total = 0;
+
+                    for (auto &file : parsed)
                     {
-                        auto files = parse(*allocator->index<true, false>(i, versions.at(i)));
-                        for (auto it = files.begin(); it != files.end(); ++it)
+                        total += file.files.size();
+                    }
+
+                    std::vector<Entry> files;
+                    files.reserve(total);
+
+                    for (auto &file : parsed)
+                    {
+                        this->versions_[file.bucket] = file.version;
+                        this->keySize_[file.bucket] = file.keySize;
+
+                        files.insert(files.end(), file.files.begin(), file.files.end());
+                        runs.push_back(files.size());
+
+                        std::vector<Entry>().swap(file.files);
+                    }
+
+                    while (runs.size() > 2)
+                    {
+                        std::vector<size_t> merged;
+                        auto pairs = (runs.size() - 1) / 2;
+
+                        auto mergePair = [&](size_t i)
+                        {
+                            std::inplace_merge(
+                                files.begin() + runs[2 * i],
+                                files.begin() + runs[2 * i + 1],
+                                files.begin() + runs[2 * i + 2]);
+                        };
+
+                        if (pool != nullptr)
+                        {
+                            pool->parallelFor(pairs, mergePair);
+                        }
+                        else
+                        {
+                            for (auto i = 0U; i < pairs; ++i)
+                            {
+                                mergePair(i);
+                            }
+                        }
+
+                        for (auto i = 0U; i < runs.size(); i += 2)
+                        {
+                            merged.push_back(runs[i]);
+                        }
+
+                        if (merged.back() != runs.back())
                         {
-                            files_.insert({ Crypto::lookup3(it->key(), 0), *it });
+                            merged.push_back(runs.back());
                         }
+
+                        runs.swap(merged);
                     }
+
+                    files_ = IO::MappedArray<Entry>(std::move(files));
                 }
 
             public:
@@ -173,10 +345,25 @@ namespace Casc
                  * Constructor.
                  */
                 Index(const std::map<uint32_t, uint32_t> &versions,
-                    std::shared_ptr<IO::StreamAllocator> allocator)
+                    std::shared_ptr<IO::StreamAllocator> allocator,
+                    std::shared_ptr<ThreadPool> pool = nullptr)
                     : versions_(versions)
                 {
-                    parse(versions, allocator);
+                    parse(versions, allocator, pool);
+                }
+
+                /**
+                 * Constructor. Loads an index written to a snapshot by save.
+                 */
+                Index(IO::SnapshotReader &reader)
+                    : files_(reader.readArray<Entry>()),
+                      versions_(reader.readMap<uint32_t, uint32_t>()),
+                      keySize_(reader.readMap<uint32_t, uint32_t>())
+                {
+                    if (!std::is_sorted(files_.begin(), files_.end()))
+                    {
+                        throw Exceptions::ParserException("The snapshot has an unsorted index.");
+                    }
                 }
 
                 /**
@@ -204,20 +391,36 @@ namespace Casc
                  */
                 virtual ~Index() = default;
 
+                /**
+                 * Gets a file record.
+                 */
+                Reference find(const IndexKey &key) const
+                {
+                    Entry entry{};
+                    entry.key = key;
+
+                    auto result = std::lower_bound(files_.begin(), files_.end(), entry);
+
+                    if (result == files_.end() || !(*result == entry))
+                    {
+                        throw Exceptions::KeyDoesNotExistException(key.string());
+                    }
+
+                    return Reference(result->key, result->file, result->offset, result->size);
+                }
+
                 /**
                  * Gets a file record.
                  */
                 template <typename KeyIt>
                 Reference find(KeyIt first, KeyIt last) const
                 {
-                    auto result = files_.find(Crypto::lookup3(first, last, 0));
-
-                    if (result == files_.end())
+                    if (size_t(last - first) < KeySize)
                     {
                         throw Exceptions::KeyDoesNotExistException(Hex(first, last).string());
                     }
 
-                    return result->second;
+                    return find(IndexKey(first, first + KeySize));
                 }
 
                 /**
@@ -229,6 +432,16 @@ namespace Casc
                     return find(std::begin(container), std::end(container));
                 }
 
+                /**
+                 * Writes the index to a snapshot.
+                 */
+                void save(IO::SnapshotWriter &writer) const
+                {
+                    writer.write(files_.data(), files_.size());
+                    writer.write(versions_);
+                    writer.write(keySize_);
+                }
+
                 /**
                  * The key size for the given bucket.
                  */
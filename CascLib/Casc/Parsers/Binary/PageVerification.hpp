@@ -0,0 +1,44 @@
+/*
+* Copyright 2015 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace Casc
+{
+    namespace Parsers
+    {
+        namespace Binary
+        {
+            /**
+             * When the MD5 of a 4 KiB encoding table page is checked.
+             */
+            enum class PageVerification
+            {
+                // Every page is checked when the file is loaded.
+                Eager,
+
+                // A page is checked the first time it is used.
+                LazyOnce,
+
+                // Pages are never checked.
+                Off
+            };
+        }
+    }
+}
\ No newline at end of file
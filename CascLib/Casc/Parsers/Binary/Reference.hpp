@@ -34,7 +34,7 @@ namespace Casc
             class Reference
             {
                 // The key of the referenced file.
-                std::vector<char> key_;
+                IndexKey key_;
 
                 // The file number.
                 // Max value of this field is 2^10 (10 bit).
@@ -54,6 +54,14 @@ namespace Casc
                  */
                 Reference() { }
 
+                /**
+                 * Constructor.
+                 */
+                Reference(const IndexKey &key, size_t file, size_t offset, size_t length)
+                    : key_(key), file_(file), offset_(offset), size_(length)
+                {
+                }
+
                 /**
                  * Constructor.
                  */
@@ -72,11 +80,13 @@ namespace Casc
                 {
                     auto it = first;
 
-                    std::vector<char> key(keySize);
-                    std::copy(it, it + keySize, key.begin());
-                    it += keySize;
+                    if (keySize != IndexKey::Size)
+                    {
+                        throw Exceptions::ParserException("Field size is outside the accepted range of the index.");
+                    }
 
-                    this->key_ = key;
+                    this->key_ = IndexKey(it, it + keySize);
+                    it += keySize;
 
                     auto offsetSize = (segmentBits + 7U) / 8U;
                     auto fileSize = locationSize - offsetSize;
@@ -133,7 +143,7 @@ namespace Casc
                 /**
                  * The key.
                  */
-                const std::vector<char> &key() const
+                const IndexKey &key() const
                 {
                     return key_;
                 }
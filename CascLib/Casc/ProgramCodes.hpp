@@ -19,6 +19,9 @@
 
 #pragma once
 
+#include <string>
+#include <utility>
+
 #include "Exceptions.hpp"
 
 namespace Casc
@@ -27,22 +30,42 @@ namespace Casc
     {
         wow,
         wowt,
-        wow_beta
+        wow_beta,
+        d3,
+        d3t,
+        d3b,
+        hero,
+        herot,
+        s2,
+        s2t,
+        pro,
+        prot
     };
 
     ProgramCode getProgramCode(std::string str)
     {
-        if (str == "wow")
-        {
-            return ProgramCode::wow;
-        }
-        else if (str == "wowt")
+        static const std::pair<const char*, ProgramCode> codes[] =
         {
-            return ProgramCode::wowt;
-        }
-        else if (str == "wow_beta")
+            { "wow", ProgramCode::wow },
+            { "wowt", ProgramCode::wowt },
+            { "wow_beta", ProgramCode::wow_beta },
+            { "d3", ProgramCode::d3 },
+            { "d3t", ProgramCode::d3t },
+            { "d3b", ProgramCode::d3b },
+            { "hero", ProgramCode::hero },
+            { "herot", ProgramCode::herot },
+            { "s2", ProgramCode::s2 },
+            { "s2t", ProgramCode::s2t },
+            { "pro", ProgramCode::pro },
+            { "prot", ProgramCode::prot }
+        };
+
+        for (auto &code : codes)
         {
-            return ProgramCode::wow_beta;
+            if (str == code.first)
+            {
+                return code.second;
+            }
         }
 
         throw Exceptions::CascException("Invalid progam code");
@@ -0,0 +1,247 @@
+/*
+* Copyright 2016 Gunnar Lilleaasen
+*
+* This file is part of CascLib.
+*
+* CascLib is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+
+* CascLib is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CascLib.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Casc
+{
+    /**
+     * A fixed set of worker threads.
+     */
+    class ThreadPool
+    {
+    private:
+        // The worker threads.
+        std::vector<std::thread> workers;
+
+        // The tasks waiting for a worker.
+        std::deque<std::function<void()>> tasks;
+
+        // Guards the tasks.
+        std::mutex mutex;
+
+        // Signals the workers when a task is added or the pool stops.
+        std::condition_variable condition;
+
+        // True when the pool is being destroyed.
+        bool stopping = false;
+
+        /**
+         * Runs tasks until the pool stops.
+         */
+        void run()
+        {
+            for (;;)
+            {
+                std::function<void()> task;
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+                    if (tasks.empty())
+                    {
+                        return;
+                    }
+
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+
+                task();
+            }
+        }
+
+    public:
+        /**
+         * Constructor. Zero threads creates one thread per hardware thread.
+         */
+        ThreadPool(size_t threads = 0)
+        {
+            if (threads == 0)
+            {
+                threads = std::max(1U, std::thread::hardware_concurrency());
+            }
+
+            for (auto i = 0U; i < threads; ++i)
+            {
+                workers.emplace_back(&ThreadPool::run, this);
+            }
+        }
+
+        /**
+         * Copy constructor.
+         */
+        ThreadPool(const ThreadPool &) = delete;
+
+        /**
+         * Copy operator.
+         */
+        ThreadPool &operator= (const ThreadPool &) = delete;
+
+        /**
+         * Destructor. Finishes the queued tasks before returning.
+         */
+        virtual ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+
+            condition.notify_all();
+
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        /**
+         * The number of worker threads.
+         */
+        size_t size() const
+        {
+            return workers.size();
+        }
+
+        /**
+         * Queues a task and returns a future for its result.
+         */
+        template <typename Function>
+        auto submit(Function fn) -> std::future<typename std::result_of<Function()>::type>
+        {
+            typedef typename std::result_of<Function()>::type result_type;
+
+            auto task = std::make_shared<std::packaged_task<result_type()>>(std::move(fn));
+            auto future = task->get_future();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.emplace_back([task]() { (*task)(); });
+            }
+
+            condition.notify_one();
+
+            return future;
+        }
+
+        /**
+         * Calls fn(i) for every i in [0, count) using the calling thread
+         * and up to size() workers. The first exception thrown is rethrown
+         * once all calls have stopped.
+         *
+         * The calling thread never waits for a worker that has not picked up
+         * its task yet, so this can safely be called from inside a task.
+         */
+        template <typename Function>
+        void parallelFor(size_t count, Function fn)
+        {
+            struct State
+            {
+                std::atomic<size_t> next{ 0 };
+                std::mutex mutex;
+                std::condition_variable condition;
+                size_t running = 0;
+                bool closed = false;
+                std::exception_ptr error;
+            };
+
+            auto state = std::make_shared<State>();
+
+            auto work = [state, count, &fn]()
+            {
+                for (size_t i; (i = state->next++) < count;)
+                {
+                    try
+                    {
+                        fn(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+
+                        if (!state->error)
+                        {
+                            state->error = std::current_exception();
+                        }
+
+                        state->next = count;
+                    }
+                }
+            };
+
+            auto helpers = std::min(size(), count > 0 ? count - 1 : 0);
+
+            for (auto i = 0U; i < helpers; ++i)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                tasks.emplace_back([state, work]()
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(state->mutex);
+
+                        if (state->closed)
+                        {
+                            return;
+                        }
+
+                        ++state->running;
+                    }
+
+                    work();
+
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    --state->running;
+                    state->condition.notify_all();
+                });
+            }
+
+            if (helpers > 0)
+            {
+                condition.notify_all();
+            }
+
+            work();
+
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->closed = true;
+            state->condition.wait(lock, [&state] { return state->running == 0; });
+
+            if (state->error)
+            {
+                std::rethrow_exception(state->error);
+            }
+        }
+    };
+}
\ No newline at end of file
@@ -217,6 +217,15 @@ public:
 
         return ss.str();
     }
+    std::array<unsigned char, 16> rawdigest() const
+    {
+        std::array<unsigned char, 16> out{};
+
+        if (finalized)
+            std::copy(digest, digest + 16, out.begin());
+
+        return out;
+    }
     friend std::ostream& operator<<(std::ostream& out, MD5 md5)
     {
         return out << md5.hexdigest();
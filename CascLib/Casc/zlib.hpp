@@ -2,8 +2,10 @@
 #include <zconf.h>
 #include <zlib.h>
 #include <exception>
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <vector>
 
 class ZError : public std::runtime_error
 {
@@ -30,7 +32,8 @@ public:
 	/*!
 	* @brief Constructor
 	*/
-	ZStreamBase()
+	ZStreamBase() :
+		z_stream_(), flush_(false), stream_end_(false)
 	{
 
 	}
@@ -64,16 +67,23 @@ public:
 	*/
 	bool isStreamEnd() const { return stream_end_; }
 
+	/*!
+	* @brief Bytes left in the output buffer after the last read
+	*
+	* @return the number of bytes that were not written
+	*/
+	size_t availOut() const { return z_stream_.avail_out; }
+
 	/*!
 	* @brief Write a buffer to the ZLib stream
 	*
 	* @param buf pointer to the buffer
 	* @param buf_size buffer size
 	*/
-	void write(char_t* buf, size_t buf_size)
+	void write(const char_t* buf, size_t buf_size)
 	{
 		z_stream_.avail_in = buf_size;
-		z_stream_.next_in = reinterpret_cast< Bytef* >(buf);
+		z_stream_.next_in = const_cast< Bytef* >(reinterpret_cast< const Bytef* >(buf));
 	}
 
 	/*!
@@ -95,25 +105,19 @@ public:
 	*/
 	void readAll(char_t** buf, size_t& buf_size)
 	{
-		std::stringstream out_stream;
-
-		char_t out_buf[ChunkSize];
+		std::vector<char_t> out;
 
 		do
 		{
-			read(out_buf, ChunkSize);
-
-			size_t out_size = ChunkSize - z_stream_.avail_out;
-			out_stream.write(reinterpret_cast< const char* >(out_buf), out_size);
-
-			if (out_stream.bad())
-				throw ZError("Error writing temporary stream");
+			out.resize(out.size() + ChunkSize);
+			read(out.data() + out.size() - ChunkSize, ChunkSize);
+			out.resize(out.size() - z_stream_.avail_out);
 
 		} while (isOutEmpty());
 
-		buf_size = out_stream.str().size();
+		buf_size = out.size();
 		*buf = new char_t[buf_size];
-		out_stream.read(reinterpret_cast< std::stringstream::char_type* >(*buf), buf_size);
+		std::copy(out.begin(), out.end(), *buf);
 	}
 
 	/*!
@@ -168,13 +172,12 @@ class ZInflateStream : public ZStreamBase
 	size_t avail_in_;
 
 public:
-	ZInflateStream(char_t* in, size_t avail_in)
+	ZInflateStream(const char_t* in, size_t avail_in)
 	{
 		z_stream_.zalloc = Z_NULL;
 		z_stream_.zfree = Z_NULL;
 		z_stream_.opaque = Z_NULL;
-		z_stream_.avail_in = avail_in;
-		z_stream_.next_in = in;
+		write(in, avail_in);
 
 		int ret = inflateInit(&z_stream_);
 
@@ -182,6 +185,21 @@ public:
 			throw ZError("Can not initialize inflate stream");
 	}
 
+	/*!
+	* @brief Restart inflating from the beginning of a new input
+	*
+	* @param in pointer to the compressed data
+	* @param avail_in compressed data size
+	*/
+	void reset(const char_t* in, size_t avail_in)
+	{
+		if (inflateReset(&z_stream_) != Z_OK)
+			throw ZError("Can not reset inflate stream");
+
+		write(in, avail_in);
+		stream_end_ = false;
+	}
+
 	~ZInflateStream()
 	{
 		inflateEnd(&z_stream_);